@@ -2,15 +2,56 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+#include <map>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <climits>
+#include <deque>
+#include <tuple>
+#include <future>
+#include <functional>
+#include <condition_variable>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__SSE2__)
+#include <immintrin.h> // Búsqueda de saltos de línea con SSE2/AVX2
+#endif
+#if defined(__cpp_impl_coroutine)
+#include <coroutine> // Las variantes con corrutinas necesitan C++20 (-std=c++20)
+#endif
 #include "nlohmann/json.hpp"
 
 using json = nlohmann::json;
 using namespace std;
 
+// Las rutas se configuran antes de usar el gestor desde varios hilos
 string jsonRAMPath = "../RAM.json";
 string jsonSwapPath = "../Swap.json";
 string filePath = "../ProgramaEjemplo.cpp";
+int pageSize = 50;
 
+// Un frame lo escribe solo quien lo tiene reservado en el bitmap del pool: el
+// proceso dueño, con su lock tomado
 struct Frame
 {
     std::string content;
@@ -19,551 +60,8796 @@ struct Frame
     int page_number;
     int process_id;
     int segment_id;
+    int pin_count; // Copia del contador de la página cargada: un frame fijado no se desaloja
+    int span = 1;  // Frames seguidos que ocupa la página que empieza aquí (páginas grandes); 0 en los demás frames de la página
 };
 
+// Entrada de la tabla de páginas de un segmento
+struct PageTableEntry
+{
+    int page_number;
+    int frame_ram;
+    int frame_swap;
+    bool presence_bit;
+    bool dirty_bit; // La página se modificó en RAM y hay que escribirla en Swap al desalojarla
+    int pin_count;  // Mientras sea mayor que 0 la página no puede elegirse como víctima
+    size_t offset; // Desplazamiento lógico donde empieza la página dentro del segmento
+    size_t size;   // Tamaño real de la página en bytes
+    // Enlaces (índices en SegmentTable::pages) de la lista de páginas desalojables del segmento
+    int prev_evictable = -1;
+    int next_evictable = -1;
+    bool evictable = false;
+};
+
+struct SegmentTable
+{
+    int segment_id;
+    std::vector<PageTableEntry> pages;
+    size_t page_size = static_cast<size_t>(pageSize); // Múltiplo de pageSize; mayor con páginas grandes
+    // Páginas residentes y no fijadas, en orden de llegada: los desalojos recorren solo
+    // esta lista y no pasan por las páginas fijadas ni por las ausentes
+    int evictable_head = -1;
+    int evictable_tail = -1;
+};
+
+// Mete la página en la lista de desalojables del segmento o la saca, según esté residente
+// y sin fijar. Se llama después de cambiar presence_bit o pin_count; cuesta O(1).
+// El llamador tiene el lock del proceso.
+void updateEvictable(SegmentTable &segmentTable, PageTableEntry &entry)
+{
+    bool evictable = entry.presence_bit && entry.pin_count == 0;
+    if (evictable == entry.evictable)
+    {
+        return;
+    }
+
+    int index = static_cast<int>(&entry - segmentTable.pages.data());
+    if (evictable)
+    {
+        entry.prev_evictable = segmentTable.evictable_tail;
+        entry.next_evictable = -1;
+        (entry.prev_evictable == -1 ? segmentTable.evictable_head : segmentTable.pages[entry.prev_evictable].next_evictable) = index;
+        segmentTable.evictable_tail = index;
+    }
+    else
+    {
+        (entry.prev_evictable == -1 ? segmentTable.evictable_head : segmentTable.pages[entry.prev_evictable].next_evictable) = entry.next_evictable;
+        (entry.next_evictable == -1 ? segmentTable.evictable_tail : segmentTable.pages[entry.next_evictable].prev_evictable) = entry.prev_evictable;
+        entry.prev_evictable = entry.next_evictable = -1;
+    }
+    entry.evictable = evictable;
+}
+
+// Rehace la lista de desalojables de un segmento cuyas entradas se crearon o copiaron de golpe
+void rebuildEvictable(SegmentTable &segmentTable)
+{
+    segmentTable.evictable_head = segmentTable.evictable_tail = -1;
+    for (auto &entry : segmentTable.pages)
+    {
+        entry.evictable = false;
+        updateEvictable(segmentTable, entry);
+    }
+}
+
+// Páginas desalojables del segmento. Se puede desalojar la página actual mientras se
+// recorre: el siguiente se lee antes de entregarla.
+template <typename Visit>
+void forEachEvictable(SegmentTable &segmentTable, Visit visit)
+{
+    for (int index = segmentTable.evictable_head; index != -1;)
+    {
+        PageTableEntry &entry = segmentTable.pages[index];
+        index = entry.next_evictable;
+        if (!visit(entry))
+        {
+            return;
+        }
+    }
+}
+
+// Traducción cacheada por la TLB
+struct TLBEntry
+{
+    bool valid;
+    int process_id;
+    int segment_id;
+    size_t virtual_page; // desplazamiento / tamaño de página del segmento, usado como etiqueta
+    int page_number;
+    int frame_ram;
+    size_t offset; // Inicio lógico de la página dentro del segmento
+    size_t size;
+    unsigned long long last_use;
+};
+
+// TLB por software asociativa por conjuntos. Guarda las traducciones
+// (proceso, segmento, página) -> frame de RAM para no recorrer las tablas "SO".
+class SoftwareTLB
+{
+public:
+    SoftwareTLB(size_t sets, size_t ways) { configure(sets, ways); }
+
+    // Cambia la geometría de la TLB (vacía todas las entradas)
+    void configure(size_t sets, size_t ways)
+    {
+        numSets = std::max<size_t>(sets, 1);
+        numWays = std::max<size_t>(ways, 1);
+        entries.assign(numSets * numWays, TLBEntry{});
+        hitCount = missCount = invalidationCount = 0;
+    }
+
+    // Busca la traducción del desplazamiento; devuelve nullptr si no está cacheada.
+    // pageBytes es el tamaño de página del segmento: una página grande usa una sola entrada.
+    const TLBEntry *lookup(int process_id, int segment_id, size_t offset, size_t pageBytes)
+    {
+        size_t virtual_page = offset / pageBytes;
+        TLBEntry *set = &entries[setIndex(process_id, segment_id, virtual_page) * numWays];
+        for (size_t way = 0; way < numWays; ++way)
+        {
+            TLBEntry &entry = set[way];
+            if (entry.valid && entry.process_id == process_id && entry.segment_id == segment_id &&
+                entry.virtual_page == virtual_page && offset >= entry.offset && offset < entry.offset + entry.size)
+            {
+                entry.last_use = ++clock;
+                hitCount++;
+                return &entry;
+            }
+        }
+        missCount++;
+        return nullptr;
+    }
+
+    // Inserta la traducción de una página residente, reemplazando la entrada menos usada del conjunto
+    void insert(int process_id, int segment_id, size_t offset, const PageTableEntry &page, size_t pageBytes)
+    {
+        size_t virtual_page = offset / pageBytes;
+        TLBEntry *set = &entries[setIndex(process_id, segment_id, virtual_page) * numWays];
+        TLBEntry *victim = &set[0];
+        for (size_t way = 0; way < numWays; ++way)
+        {
+            if (!set[way].valid)
+            {
+                victim = &set[way];
+                break;
+            }
+            if (set[way].last_use < victim->last_use)
+            {
+                victim = &set[way];
+            }
+        }
+        *victim = {true, process_id, segment_id, virtual_page, page.page_number, page.frame_ram, page.offset, page.size, ++clock};
+    }
+
+    // Invalida todas las traducciones de una página (se llama al desalojarla)
+    void invalidatePage(int process_id, int segment_id, int page_number)
+    {
+        for (auto &entry : entries)
+        {
+            if (entry.valid && entry.process_id == process_id && entry.segment_id == segment_id && entry.page_number == page_number)
+            {
+                entry.valid = false;
+                invalidationCount++;
+            }
+        }
+    }
+
+    // Indica si alguna traducción de la página está cacheada (no cuenta como acceso)
+    bool contains(int process_id, int segment_id, int page_number) const
+    {
+        for (const auto &entry : entries)
+        {
+            if (entry.valid && entry.process_id == process_id && entry.segment_id == segment_id && entry.page_number == page_number)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Invalida todas las traducciones de un proceso (se llama al liberar su memoria)
+    void invalidateProcess(int process_id)
+    {
+        for (auto &entry : entries)
+        {
+            if (entry.valid && entry.process_id == process_id)
+            {
+                entry.valid = false;
+                invalidationCount++;
+            }
+        }
+    }
+
+    long long hits() const { return hitCount; }
+    long long misses() const { return missCount; }
+    long long invalidations() const { return invalidationCount; }
+
+private:
+    size_t setIndex(int process_id, int segment_id, size_t virtual_page) const
+    {
+        size_t hash = static_cast<size_t>(process_id) * 0x9E3779B1u ^ static_cast<size_t>(segment_id) * 0x85EBCA6Bu ^ virtual_page;
+        return hash % numSets;
+    }
+
+    std::vector<TLBEntry> entries;
+    size_t numSets = 1;
+    size_t numWays = 1;
+    unsigned long long clock = 0;
+    long long hitCount = 0;
+    long long missCount = 0;
+    long long invalidationCount = 0;
+};
+
+// Geometría con la que se crea la TLB de cada proceso
+size_t tlbSets = 16;
+size_t tlbWays = 4;
+
+// Estadísticas acumuladas de la TLB
+struct TLBStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long invalidations = 0;
+};
+
+// Tabla de páginas de un proceso. Cada proceso tiene su propia TLB y su propio lock,
+// así los fallos de procesos distintos se atienden en paralelo.
+struct ProcessTable
+{
+    int process_id;
+    std::vector<SegmentTable> segments;
+    SoftwareTLB tlb{tlbSets, tlbWays};
+    std::mutex lock;
+    // Con la imagen compartida: alta del proceso en la región y versión de sus páginas que
+    // refleja esta tabla. Si la región tiene otra versión, la tabla se recarga.
+    uint64_t shared_incarnation = 0;
+    uint64_t shared_version = 0;
+};
+
+// Imagen en memoria de RAM.json y Swap.json. Es la copia de trabajo: las operaciones
+// la modifican y persistMemoryImage la vuelca a los archivos.
+//
+// Orden de adquisición de locks (siempre en este orden para evitar interbloqueos):
+//   0. Con la imagen compartida, los locks de los procesos en la región
+//      (SharedImageTransaction), por process_id ascendente. Con imageMutex tomado solo
+//      se intentan sin esperar.
+//   1. imageMutex: compartido en las operaciones normales; exclusivo para crear o
+//      liberar procesos, cambiar la TLB y cargar o guardar la imagen.
+//   2. ProcessTable::lock; si se necesitan varios, por process_id ascendente.
+// Los frames libres de RAM y Swap se reservan sin locks en ramPool y swapPool: cada
+// shard tiene su bitmap y sus magazines por hilo.
+// Quien reserva un frame es el único que escribe en él hasta liberarlo; las lecturas
+// de metadatos de todos los frames (persistencia) toman imageMutex exclusivo.
+// Las consultas (freeMem, usedMem, pinnedMem) no toman ningún lock: leen contadores que
+// cada reserva, liberación y fijación mantiene al día (ver FrameCounters).
+std::vector<Frame> ramFrames;
+std::vector<Frame> swapFrames;
+std::unordered_map<int, std::shared_ptr<ProcessTable>> pageTables;
+std::shared_mutex imageMutex;
+std::atomic<bool> imageLoaded{false};
+std::atomic<bool> ramImageModified{false};
+std::atomic<bool> swapImageModified{false};
+
+// Si está activo, cada operación guarda los JSON al terminar (serializa las operaciones).
+// Por defecto está desactivado: las operaciones solo tocan la imagen en memoria y se llama
+// a persistMemoryImage cuando se quiera un punto de control.
+bool writeThroughPersistence = false;
+std::mutex persistMutex; // Se toma antes que imageMutex
+
+// Si está activo, uploadToRam fija la primera página de cada segmento en RAM
+bool pinFirstPageOfSegment = false;
+
+// Páginas grandes: los segmentos de al menos hugePageMinBytes se paginan con páginas de
+// hugePageFrames frames seguidos, con una sola entrada en la tabla de páginas y en la TLB
+// por página. Con hugePageFrames = 1 todos los segmentos usan páginas de pageSize.
+int hugePageFrames = 1;
+size_t hugePageMinBytes = 64 * 1024;
+const int maxHugePageFrames = 64; // Los frames de una página grande caben en una palabra del bitmap
+
+// Frames que tiene un process_id (los que llevan su process_id)
+struct ProcessFrameCounters
+{
+    std::atomic<int> ram_frames{0};
+    std::atomic<int> swap_frames{0};
+    std::atomic<int> pinned_frames{0}; // Frames de RAM fijados, contando todos los de una página grande
+};
+
+// Contadores de frames de toda la imagen. Cada reserva, liberación y fijación los
+// actualiza en el momento, así las consultas ni recorren los frames ni esperan a nadie.
+struct FrameCounters
+{
+    std::atomic<int> free_ram{0};
+    std::atomic<int> free_swap{0};
+    std::atomic<int> pinned_ram{0};
+};
+
+// Página de un proceso en la imagen compartida. Toda página tiene su propio frame de Swap
+// (la imagen compartida no admite frames compartidos), así que su estado se guarda en la
+// posición de ese frame y las páginas de cada proceso se encadenan con next.
+struct SharedPage
+{
+    int32_t process_id;
+    int32_t segment_id;
+    int32_t page_number;
+    int32_t frame_ram;
+    int32_t pin_count;
+    int32_t next; // Frame de Swap de la página siguiente del proceso, o -1
+    uint8_t presence_bit;
+    uint8_t dirty_bit;
+    uint64_t size;
+    uint64_t page_size; // Tamaño de página del segmento
+};
+
+// Proceso de la imagen compartida. Su mutex protege las páginas del proceso y los frames
+// que tiene; version aumenta con cada cambio, así cada participante sabe si su tabla
+// sigue al día. incarnation distingue un process_id que se liberó y se volvió a crear.
+struct SharedProcessSlot
+{
+    pthread_mutex_t mutex; // Robusto, recursivo y compartido entre procesos
+    std::atomic<uint32_t> state;
+    std::atomic<int32_t> process_id;
+    std::atomic<uint32_t> published; // Sus páginas están completas en la región
+    std::atomic<uint64_t> incarnation;
+    std::atomic<uint64_t> version;
+    int32_t segment_count;
+    int32_t first_page;
+    ProcessFrameCounters counters;
+};
+
+struct SharedImageHeader
+{
+    std::atomic<uint32_t> magic;      // Se escribe al final de la inicialización
+    std::atomic<int32_t> creator_pid; // Quien la inicializa, para no esperar a un proceso muerto
+    pthread_mutex_t directory_mutex;  // Para dar de alta y de baja procesos
+    std::atomic<uint64_t> directory_version;
+    FrameCounters counters;
+    uint64_t page_size;
+    uint64_t frame_bytes; // Bytes de contenido que caben en un frame
+    uint64_t ram_frames;
+    uint64_t swap_frames;
+    uint64_t process_capacity;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "La imagen compartida necesita atómicos sin locks");
+
+// Imagen de la memoria en una región shm_open/mmap que comparten varios procesos del
+// sistema operativo. Todo el estado vive en la región: los bitmaps de frames libres (los
+// pools reservan directamente en ellos), los contadores, el contenido de los frames, las
+// páginas de cada proceso y un mutex robusto por proceso. Cada participante guarda una
+// copia local de las tablas y la recarga solo cuando cambia la versión del proceso en la
+// región, así las operaciones sobre procesos distintos no se esperan entre sí.
+//
+// Disposición: cabecera, procesos, páginas (una por frame de Swap), bitmaps de RAM y Swap,
+// tamaño del contenido de cada frame y contenido, frame_bytes por frame y seguido (una
+// página grande ocupa un solo tramo).
+class SharedImage
+{
+public:
+    static const uint32_t MAGIC = 0x4D4D5332; // "MMS2"
+    static const uint32_t SLOT_EMPTY = 0;
+    static const uint32_t SLOT_USED = 1;
+    static const uint32_t SLOT_RELEASED = 2; // Libre, pero las búsquedas siguen de largo
+
+    bool attached() const { return header != nullptr; }
+
+    // Abre la región name si existe (si no, deja missing a true). Espera como mucho timeout
+    // a que su creador termine de inicializarla y deja de esperar si el creador murió.
+    bool open(const std::string &name, std::chrono::milliseconds timeout, bool &missing)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR, 0600);
+        missing = fd == -1 && errno == ENOENT;
+        if (fd == -1)
+        {
+            if (!missing)
+            {
+                std::cerr << "No se pudo abrir la memoria compartida: " << name << std::endl;
+            }
+            return false;
+        }
+
+        // El tamaño lo fija quien creó la región; hasta que ftruncate termina es 0
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        struct stat info{};
+        while (fstat(fd, &info) == 0 && info.st_size == 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        if (info.st_size < static_cast<off_t>(sizeof(SharedImageHeader)))
+        {
+            std::cerr << "Tiempo agotado esperando la memoria compartida: " << name << std::endl;
+            close(fd);
+            return false;
+        }
+
+        size_t bytes = static_cast<size_t>(info.st_size);
+        void *address = mapRegion(fd, bytes, name);
+        if (address == nullptr)
+        {
+            return false;
+        }
+        SharedImageHeader *mapped = static_cast<SharedImageHeader *>(address);
+        if (!waitReady(*mapped, deadline, name))
+        {
+            munmap(address, bytes);
+            return false;
+        }
+        Layout layout = layoutFor(mapped->ram_frames, mapped->swap_frames, mapped->process_capacity, mapped->frame_bytes);
+        if (mapped->page_size != static_cast<uint64_t>(pageSize) || layout.bytes > bytes)
+        {
+            std::cerr << "La memoria compartida usa otro tamaño de página: " << name << std::endl;
+            munmap(address, bytes);
+            return false;
+        }
+        useRegion(address, bytes, layout, name);
+        return true;
+    }
+
+    // Crea la región name con la geometría dada; quien llama la llena y después llama a
+    // ready. Si ya existe deja exists a true.
+    bool create(const std::string &name, size_t ramCount, size_t swapCount, size_t processCapacity, size_t frameBytes, bool &exists)
+    {
+        int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        exists = fd == -1 && errno == EEXIST;
+        if (fd == -1)
+        {
+            if (!exists)
+            {
+                std::cerr << "No se pudo crear la memoria compartida: " << name << std::endl;
+            }
+            return false;
+        }
+
+        Layout layout = layoutFor(ramCount, swapCount, processCapacity, frameBytes);
+        void *address = nullptr;
+        if (ftruncate(fd, static_cast<off_t>(layout.bytes)) != 0)
+        {
+            std::cerr << "No se pudo reservar la memoria compartida: " << name << std::endl;
+            close(fd);
+        }
+        else
+        {
+            address = mapRegion(fd, layout.bytes, name);
+        }
+        if (address == nullptr)
+        {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        // La región recién creada está a cero: procesos vacíos y todos los frames ocupados
+        SharedImageHeader *mapped = static_cast<SharedImageHeader *>(address);
+        mapped->creator_pid.store(static_cast<int32_t>(getpid()));
+        initializeMutex(mapped->directory_mutex);
+        mapped->page_size = static_cast<uint64_t>(pageSize);
+        mapped->frame_bytes = frameBytes;
+        mapped->ram_frames = ramCount;
+        mapped->swap_frames = swapCount;
+        mapped->process_capacity = processCapacity;
+        useRegion(address, layout.bytes, layout, name);
+        for (size_t i = 0; i < processCapacity; ++i)
+        {
+            initializeMutex(slots[i].mutex);
+        }
+        return true;
+    }
+
+    // Marca como lista la región que se acaba de crear y llenar
+    void ready()
+    {
+        header->magic.store(MAGIC, std::memory_order_release);
+    }
+
+    // Deja de usar la región; con remove además la borra del sistema
+    void detach(bool remove)
+    {
+        if (header == nullptr)
+        {
+            return;
+        }
+        munmap(header, mappedBytes);
+        header = nullptr;
+        if (remove)
+        {
+            shm_unlink(regionName.c_str());
+        }
+    }
+
+    size_t ramCount() const { return header->ram_frames; }
+    size_t swapCount() const { return header->swap_frames; }
+    std::atomic<uint64_t> *ramBitmap() const { return ramWords; }
+    std::atomic<uint64_t> *swapBitmap() const { return swapWords; }
+    FrameCounters *counters() const { return &header->counters; }
+
+    // Contadores del proceso en la región, o nullptr si no está dado de alta
+    ProcessFrameCounters *processCounters(int process_id) const
+    {
+        int index = findSlot(process_id);
+        return index == -1 ? nullptr : &slots[index].counters;
+    }
+
+    // Contenido de los frames. Solo lo escribe el dueño del frame, con el lock de su proceso.
+    std::string_view ramContent(int frame_number) const
+    {
+        return {ramData + frame_number * bytesPerFrame, ramSizes[frame_number]};
+    }
+
+    std::string_view swapContent(int frame_number) const
+    {
+        return {swapData + frame_number * bytesPerFrame, swapSizes[frame_number]};
+    }
+
+    void setRamContent(int frame_number, std::string_view content)
+    {
+        ramSizes[frame_number] = static_cast<uint32_t>(copyContent(ramData, header->ram_frames, frame_number, 0, content));
+    }
+
+    void setSwapContent(int frame_number, std::string_view content)
+    {
+        swapSizes[frame_number] = static_cast<uint32_t>(copyContent(swapData, header->swap_frames, frame_number, 0, content));
+    }
+
+    // Sobrescribe bytes del contenido de un frame de RAM sin cambiar su tamaño
+    void writeRam(int frame_number, size_t offset, std::string_view bytes)
+    {
+        copyContent(ramData, header->ram_frames, frame_number, offset, bytes);
+    }
+
+    // Posición del proceso en la región, o -1. No toma locks.
+    int findSlot(int process_id) const
+    {
+        size_t capacity = header->process_capacity;
+        size_t index = slotHash(process_id);
+        for (size_t n = 0; n < capacity; ++n, index = (index + 1) % capacity)
+        {
+            const SharedProcessSlot &slot = slots[index];
+            uint32_t state = slot.state.load(std::memory_order_acquire);
+            if (state == SLOT_EMPTY)
+            {
+                return -1;
+            }
+            if (state == SLOT_USED && slot.process_id.load() == process_id)
+            {
+                return static_cast<int>(index);
+            }
+        }
+        return -1;
+    }
+
+    // Da de alta el proceso, aún sin publicar, o devuelve su posición si ya existe.
+    // Devuelve -1 si no caben más procesos.
+    int createSlot(int process_id)
+    {
+        lockDirectory();
+        int existing = findSlot(process_id);
+        if (existing != -1)
+        {
+            unlockDirectory();
+            return existing;
+        }
+
+        size_t capacity = header->process_capacity;
+        size_t index = slotHash(process_id);
+        for (size_t n = 0; n < capacity; ++n, index = (index + 1) % capacity)
+        {
+            SharedProcessSlot &slot = slots[index];
+            if (slot.state.load() == SLOT_USED)
+            {
+                continue;
+            }
+            slot.process_id.store(process_id);
+            slot.published.store(0);
+            slot.incarnation.store(header->directory_version.fetch_add(1) + 1);
+            slot.version.store(1);
+            slot.segment_count = 0;
+            slot.first_page = -1;
+            slot.counters.ram_frames = 0;
+            slot.counters.swap_frames = 0;
+            slot.counters.pinned_frames = 0;
+            slot.state.store(SLOT_USED, std::memory_order_release);
+            unlockDirectory();
+            return static_cast<int>(index);
+        }
+        unlockDirectory();
+        std::cerr << "La memoria compartida no admite más procesos: " << regionName << std::endl;
+        return -1;
+    }
+
+    // Da de baja el proceso de esa posición. El llamador tiene su lock.
+    void releaseSlot(int index)
+    {
+        lockDirectory();
+        slots[index].state.store(SLOT_RELEASED, std::memory_order_release);
+        header->directory_version++;
+        unlockDirectory();
+    }
+
+    // Toma el lock del proceso y comprueba que la posición sigue siendo suya. Si el dueño
+    // anterior murió con el lock tomado, las páginas pueden haber quedado a medias: se
+    // marca el lock como consistente y se cambia la versión para que todos las recarguen.
+    bool lockSlot(int index, int process_id, bool tryOnly)
+    {
+        SharedProcessSlot &slot = slots[index];
+        int result = tryOnly ? pthread_mutex_trylock(&slot.mutex) : pthread_mutex_lock(&slot.mutex);
+        if (result == EOWNERDEAD)
+        {
+            pthread_mutex_consistent(&slot.mutex);
+            slot.version++;
+        }
+        else if (result != 0)
+        {
+            return false;
+        }
+        if (slot.state.load() != SLOT_USED || slot.process_id.load() != process_id)
+        {
+            pthread_mutex_unlock(&slot.mutex);
+            return false;
+        }
+        return true;
+    }
+
+    void unlockSlot(int index)
+    {
+        pthread_mutex_unlock(&slots[index].mutex);
+    }
+
+    uint64_t slotVersion(int index) const { return slots[index].version.load(); }
+    bool slotPublished(int index) const { return slots[index].published.load() != 0; }
+
+    // Cambia con cada alta, baja y publicación de un proceso
+    uint64_t directoryVersion() const { return header->directory_version.load(); }
+
+    // Versión de la lista de procesos que reflejan las tablas locales
+    std::atomic<uint64_t> seenDirectory{0};
+
+    // Procesos publicados: visit(process_id, incarnation). No toma locks.
+    template <typename Visit>
+    void forEachProcess(Visit visit) const
+    {
+        for (size_t i = 0; i < header->process_capacity; ++i)
+        {
+            const SharedProcessSlot &slot = slots[i];
+            if (slot.state.load(std::memory_order_acquire) == SLOT_USED && slot.published.load() != 0)
+            {
+                visit(slot.process_id.load(), slot.incarnation.load());
+            }
+        }
+    }
+
+    // Escribe en la región todas las páginas de la tabla y la publica.
+    // El llamador tiene el lock del proceso en la región.
+    bool publishProcess(ProcessTable &table)
+    {
+        int index = findSlot(table.process_id);
+        if (index == -1)
+        {
+            std::cerr << "El proceso no está dado de alta en la memoria compartida: " << table.process_id << std::endl;
+            return false;
+        }
+
+        for (const auto &segmentTable : table.segments)
+        {
+            for (const auto &entry : segmentTable.pages)
+            {
+                if (entry.frame_swap < 0)
+                {
+                    std::cerr << "La memoria compartida necesita la copia en Swap de todas las páginas" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        SharedProcessSlot &slot = slots[index];
+        int first = -1;
+        int *link = &first;
+        for (const auto &segmentTable : table.segments)
+        {
+            for (const auto &entry : segmentTable.pages)
+            {
+                SharedPage &page = pages[entry.frame_swap];
+                page = {table.process_id, segmentTable.segment_id, entry.page_number, entry.frame_ram, entry.pin_count, -1,
+                        entry.presence_bit, entry.dirty_bit, entry.size, segmentTable.page_size};
+                *link = entry.frame_swap;
+                link = &page.next;
+            }
+        }
+        slot.segment_count = static_cast<int32_t>(table.segments.size());
+        slot.first_page = first;
+        table.shared_incarnation = slot.incarnation.load();
+        table.shared_version = slot.version.fetch_add(1) + 1;
+        slot.published.store(1);
+        header->directory_version++;
+        return true;
+    }
+
+    // Quita de la región las páginas del proceso (sus frames ya se liberaron). Sigue dado
+    // de alta hasta que termine la operación, que puede volver a publicarlo.
+    void unpublishProcess(int process_id)
+    {
+        if (header == nullptr)
+        {
+            return;
+        }
+        int index = findSlot(process_id);
+        if (index == -1)
+        {
+            return;
+        }
+        SharedProcessSlot &slot = slots[index];
+        slot.published.store(0);
+        slot.segment_count = 0;
+        slot.first_page = -1;
+        slot.version++;
+        header->directory_version++;
+    }
+
+    // Copia a la región el estado de una página que cambió.
+    // El llamador tiene el lock del proceso en la región.
+    void storePage(ProcessTable &table, const PageTableEntry &entry)
+    {
+        if (header == nullptr || entry.frame_swap < 0)
+        {
+            return;
+        }
+        SharedPage &page = pages[entry.frame_swap];
+        page.frame_ram = entry.frame_ram;
+        page.pin_count = entry.pin_count;
+        page.presence_bit = entry.presence_bit;
+        page.dirty_bit = entry.dirty_bit;
+        int index = findSlot(table.process_id);
+        if (index != -1)
+        {
+            // La tabla estaba al día (se tiene el lock del proceso): sigue estándolo
+            table.shared_version = slots[index].version.fetch_add(1) + 1;
+        }
+    }
+
+    // Rehace la tabla local del proceso con sus páginas de la región y pone al día los
+    // metadatos locales de sus frames. El llamador tiene el lock del proceso en la región,
+    // imageMutex y el lock de la tabla.
+    void loadProcess(ProcessTable &table, int index)
+    {
+        const SharedProcessSlot &slot = slots[index];
+        std::vector<SegmentTable> segments(static_cast<size_t>(std::max(slot.segment_count, 0)));
+        for (size_t i = 0; i < segments.size(); ++i)
+        {
+            segments[i].segment_id = static_cast<int>(i + 1);
+        }
+
+        // Las páginas están encadenadas en el orden de la tabla
+        for (int p = slot.first_page; p != -1; p = pages[p].next)
+        {
+            const SharedPage &page = pages[p];
+            if (page.segment_id < 1 || page.segment_id > static_cast<int>(segments.size()))
+            {
+                continue;
+            }
+            SegmentTable &segmentTable = segments[page.segment_id - 1];
+            segmentTable.page_size = page.page_size;
+            PageTableEntry entry{page.page_number, page.frame_ram, p, page.presence_bit != 0, page.dirty_bit != 0,
+                                 page.pin_count, 0, page.size};
+            entry.offset = segmentTable.pages.empty() ? 0 : segmentTable.pages.back().offset + segmentTable.pages.back().size;
+            segmentTable.pages.push_back(entry);
+
+            int span = std::max(static_cast<int>(page.page_size / static_cast<uint64_t>(pageSize)), 1);
+            markFrames(swapFrames, p, span, page, 0);
+            if (entry.presence_bit)
+            {
+                markFrames(ramFrames, entry.frame_ram, span, page, entry.pin_count);
+            }
+        }
+        for (auto &segmentTable : segments)
+        {
+            rebuildEvictable(segmentTable);
+        }
+
+        table.segments = std::move(segments);
+        table.tlb.invalidateProcess(table.process_id);
+        table.shared_incarnation = slot.incarnation.load();
+        table.shared_version = slot.version.load();
+    }
+
+private:
+    struct Layout
+    {
+        size_t slots;
+        size_t pages;
+        size_t ramWords;
+        size_t swapWords;
+        size_t ramSizes;
+        size_t swapSizes;
+        size_t ramData;
+        size_t swapData;
+        size_t bytes;
+    };
+
+    // Posición de cada parte en la región; cada una empieza en su propia línea de caché
+    static Layout layoutFor(size_t ramCount, size_t swapCount, size_t processCapacity, size_t frameBytes)
+    {
+        size_t offset = 0;
+        auto place = [&offset](size_t bytes)
+        {
+            size_t at = offset;
+            offset = (offset + bytes + 63) / 64 * 64;
+            return at;
+        };
+        place(sizeof(SharedImageHeader));
+        Layout layout;
+        layout.slots = place(processCapacity * sizeof(SharedProcessSlot));
+        layout.pages = place(swapCount * sizeof(SharedPage));
+        layout.ramWords = place((ramCount + 63) / 64 * sizeof(uint64_t));
+        layout.swapWords = place((swapCount + 63) / 64 * sizeof(uint64_t));
+        layout.ramSizes = place(ramCount * sizeof(uint32_t));
+        layout.swapSizes = place(swapCount * sizeof(uint32_t));
+        layout.ramData = place(ramCount * frameBytes);
+        layout.swapData = place(swapCount * frameBytes);
+        layout.bytes = offset;
+        return layout;
+    }
+
+    static void *mapRegion(int fd, size_t bytes, const std::string &name)
+    {
+        void *address = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (address == MAP_FAILED)
+        {
+            std::cerr << "No se pudo proyectar la memoria compartida: " << name << std::endl;
+            return nullptr;
+        }
+        return address;
+    }
+
+    void useRegion(void *address, size_t bytes, const Layout &layout, const std::string &name)
+    {
+        char *base = static_cast<char *>(address);
+        header = static_cast<SharedImageHeader *>(address);
+        mappedBytes = bytes;
+        regionName = name;
+        bytesPerFrame = header->frame_bytes;
+        slots = reinterpret_cast<SharedProcessSlot *>(base + layout.slots);
+        pages = reinterpret_cast<SharedPage *>(base + layout.pages);
+        ramWords = reinterpret_cast<std::atomic<uint64_t> *>(base + layout.ramWords);
+        swapWords = reinterpret_cast<std::atomic<uint64_t> *>(base + layout.swapWords);
+        ramSizes = reinterpret_cast<uint32_t *>(base + layout.ramSizes);
+        swapSizes = reinterpret_cast<uint32_t *>(base + layout.swapSizes);
+        ramData = base + layout.ramData;
+        swapData = base + layout.swapData;
+        seenDirectory = ~0ull;
+    }
+
+    static void initializeMutex(pthread_mutex_t &mutex)
+    {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+        pthread_mutex_init(&mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+    }
+
+    // Espera a que el creador de la región termine de inicializarla
+    static bool waitReady(SharedImageHeader &mapped, std::chrono::steady_clock::time_point deadline, const std::string &name)
+    {
+        while (mapped.magic.load(std::memory_order_acquire) != MAGIC)
+        {
+            pid_t creator = mapped.creator_pid.load();
+            if (creator > 0 && kill(creator, 0) == -1 && errno == ESRCH)
+            {
+                std::cerr << "El proceso que creaba la memoria compartida terminó sin inicializarla: " << name << std::endl;
+                return false;
+            }
+            if (std::chrono::steady_clock::now() >= deadline)
+            {
+                std::cerr << "Tiempo agotado esperando la memoria compartida: " << name << std::endl;
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    size_t slotHash(int process_id) const
+    {
+        return static_cast<size_t>(static_cast<uint32_t>(process_id) * 0x9E3779B1u) % header->process_capacity;
+    }
+
+    // Las altas y bajas se serializan; un proceso que muere a mitad deja como mucho un
+    // slot sin marcar como usado
+    void lockDirectory()
+    {
+        if (pthread_mutex_lock(&header->directory_mutex) == EOWNERDEAD)
+        {
+            pthread_mutex_consistent(&header->directory_mutex);
+        }
+    }
+
+    void unlockDirectory()
+    {
+        pthread_mutex_unlock(&header->directory_mutex);
+    }
+
+    // Copia bytes al contenido de un frame sin salirse de la tabla. Devuelve lo copiado
+    // más offset: el tamaño que queda si se escribe desde el principio.
+    size_t copyContent(char *data, size_t frameCount, int frame_number, size_t offset, std::string_view bytes)
+    {
+        size_t start = static_cast<size_t>(frame_number) * bytesPerFrame + offset;
+        size_t limit = frameCount * bytesPerFrame;
+        size_t length = std::min(bytes.size(), start < limit ? limit - start : 0);
+        if (length < bytes.size())
+        {
+            std::cerr << "La página no cabe en la memoria compartida: " << regionName << std::endl;
+        }
+        std::memcpy(data + start, bytes.data(), length);
+        return offset + length;
+    }
+
+    static void markFrames(std::vector<Frame> &frames, int first, int span, const SharedPage &page, int pin_count)
+    {
+        for (int i = 0; i < span && first + i < static_cast<int>(frames.size()); ++i)
+        {
+            Frame &frame = frames[first + i];
+            frame.is_free = false;
+            frame.process_id = page.process_id;
+            frame.segment_id = page.segment_id;
+            frame.page_number = page.page_number;
+            frame.pin_count = pin_count;
+            frame.span = i == 0 ? span : 0;
+        }
+    }
+
+    SharedImageHeader *header = nullptr;
+    SharedProcessSlot *slots = nullptr;
+    SharedPage *pages = nullptr;
+    std::atomic<uint64_t> *ramWords = nullptr;
+    std::atomic<uint64_t> *swapWords = nullptr;
+    uint32_t *ramSizes = nullptr;
+    uint32_t *swapSizes = nullptr;
+    char *ramData = nullptr;
+    char *swapData = nullptr;
+    size_t bytesPerFrame = 0;
+    size_t mappedBytes = 0;
+    std::string regionName;
+
+};
+
+SharedImage sharedImage;
+
+// Contadores de la imagen local; con la imagen compartida se usan los de la región
+FrameCounters localFrameCounters;
+std::atomic<FrameCounters *> activeFrameCounters{&localFrameCounters};
+
+FrameCounters &frameCounters()
+{
+    return *activeFrameCounters.load(std::memory_order_acquire);
+}
+
+// Contenido del frame de RAM (el de una página grande empieza en su primer frame)
+std::string_view ramPageContent(int frame_number)
+{
+    if (sharedImage.attached())
+    {
+        return sharedImage.ramContent(frame_number);
+    }
+    return ramFrames[frame_number].content;
+}
+
+void setRamPageContent(int frame_number, std::string_view content)
+{
+    if (sharedImage.attached())
+    {
+        sharedImage.setRamContent(frame_number, content);
+        return;
+    }
+    ramFrames[frame_number].content = std::string(content);
+}
+
+// Sobrescribe bytes del contenido de un frame de RAM sin cambiar su tamaño
+void writeRamPageBytes(int frame_number, size_t offset, std::string_view bytes)
+{
+    if (sharedImage.attached())
+    {
+        sharedImage.writeRam(frame_number, offset, bytes);
+        return;
+    }
+    ramFrames[frame_number].content.replace(offset, bytes.size(), bytes);
+}
+
+// Se llama después de cambiar el estado de una página (frame, presencia, fijación o bit
+// de modificación): actualiza la lista de desalojables y, con la imagen compartida, copia
+// el estado a la región. El llamador tiene el lock del proceso.
+void pageEntryChanged(ProcessTable &table, SegmentTable &segmentTable, PageTableEntry &entry)
+{
+    updateEvictable(segmentTable, entry);
+    sharedImage.storePage(table, entry);
+}
+
+// Estadísticas de la TLB de los procesos ya liberados
+TLBStats retiredTLBStats;
+
+// Estadísticas de desalojo: las páginas limpias ya tienen copia válida en Swap y no se escriben
+struct EvictionStats
+{
+    std::atomic<long long> clean_evictions{0};
+    std::atomic<long long> dirty_evictions{0};
+    std::atomic<long long> bytes_written_back{0};
+    std::atomic<long long> bytes_saved{0}; // Bytes que no se escribieron en Swap gracias al bit de modificación
+};
+
+EvictionStats evictionStats;
+
+// Marcas de frames libres de RAM del reclamador en segundo plano, en porcentaje de los
+// frames de RAM: por debajo de la baja se despierta y desaloja hasta llegar a la alta
+int reclaimLowPercent = 10;
+int reclaimHighPercent = 20;
+
+// Estadísticas de reclamo: directo (lo hace el fallo de página) o en segundo plano
+struct ReclaimStats
+{
+    std::atomic<long long> direct_reclaims{0};         // Páginas desalojadas al atender un fallo
+    std::atomic<long long> background_reclaims{0};     // Páginas desalojadas por el reclamador
+    std::atomic<long long> wakeups{0};                 // Pasadas del reclamador bajo la marca baja
+    std::atomic<long long> faults_without_eviction{0}; // Fallos que encontraron un frame libre sin desalojar
+};
+
+ReclaimStats reclaimStats;
+
+// Compresor del contenido de las páginas, de la familia LZ77 con un formato parecido a
+// LZ4. Cada secuencia es un byte de control (longitud de los literales en los 4 bits
+// altos y longitud de la coincidencia menos 4 en los bajos; 15 indica que siguen bytes
+// de 255 y un resto), los literales, y un desplazamiento de 2 bytes hacia atrás a la
+// coincidencia. La última secuencia solo tiene literales.
+const size_t lzMinMatch = 4;
+const size_t lzMaxOffset = 65535;
+const int lzHashBits = 12;
+
+void lzWriteLength(std::string &output, size_t length)
+{
+    for (; length >= 255; length -= 255)
+    {
+        output.push_back(static_cast<char>(255));
+    }
+    output.push_back(static_cast<char>(length));
+}
+
+void lzWriteSequence(std::string &output, std::string_view literals, size_t offset, size_t matchLength)
+{
+    size_t match = matchLength == 0 ? 0 : matchLength - lzMinMatch;
+    output.push_back(static_cast<char>((std::min<size_t>(literals.size(), 15) << 4) | std::min<size_t>(match, 15)));
+    if (literals.size() >= 15)
+    {
+        lzWriteLength(output, literals.size() - 15);
+    }
+    output.append(literals);
+    if (matchLength == 0)
+    {
+        return;
+    }
+    output.push_back(static_cast<char>(offset & 0xff));
+    output.push_back(static_cast<char>(offset >> 8));
+    if (match >= 15)
+    {
+        lzWriteLength(output, match - 15);
+    }
+}
+
+std::string lzCompress(std::string_view input)
+{
+    // Posiciones vistas por hash de 4 bytes. No se limpia entre llamadas: una posición
+    // vieja solo se usa si cae antes de la actual y sus 4 bytes coinciden de verdad.
+    thread_local uint32_t table[1 << lzHashBits] = {};
+
+    std::string output;
+    output.reserve(input.size() + input.size() / 255 + 16);
+    const char *data = input.data();
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + lzMinMatch <= input.size())
+    {
+        uint32_t sequence;
+        std::memcpy(&sequence, data + pos, sizeof(sequence));
+        uint32_t &slot = table[(sequence * 2654435761u) >> (32 - lzHashBits)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(pos);
+        if (candidate >= pos || pos - candidate > lzMaxOffset || std::memcmp(data + candidate, data + pos, lzMinMatch) != 0)
+        {
+            pos++;
+            continue;
+        }
+
+        size_t length = lzMinMatch;
+        while (pos + length < input.size() && data[candidate + length] == data[pos + length])
+        {
+            length++;
+        }
+        lzWriteSequence(output, input.substr(anchor, pos - anchor), pos - candidate, length);
+        pos += length;
+        anchor = pos;
+    }
+    lzWriteSequence(output, input.substr(anchor), 0, 0);
+    return output;
+}
+
+// Descomprime un bloque de lzCompress. Devuelve false si el bloque está mal formado o no
+// da exactamente originalSize bytes.
+bool lzDecompress(std::string_view input, size_t originalSize, std::string &output)
+{
+    output.resize(originalSize);
+    char *out = output.data();
+    size_t written = 0;
+    size_t pos = 0;
+    auto readLength = [&](size_t length, size_t &result)
+    {
+        result = length;
+        if (length < 15)
+        {
+            return true;
+        }
+        unsigned char byte;
+        do
+        {
+            if (pos >= input.size())
+            {
+                return false;
+            }
+            byte = static_cast<unsigned char>(input[pos++]);
+            result += byte;
+        } while (byte == 255);
+        return true;
+    };
+
+    while (pos < input.size())
+    {
+        unsigned char token = static_cast<unsigned char>(input[pos++]);
+        size_t literals;
+        if (!readLength(token >> 4, literals) || literals > input.size() - pos || literals > originalSize - written)
+        {
+            return false;
+        }
+        std::memcpy(out + written, input.data() + pos, literals);
+        written += literals;
+        pos += literals;
+        if (pos == input.size())
+        {
+            break;
+        }
+
+        size_t match;
+        if (input.size() - pos < 2)
+        {
+            return false;
+        }
+        size_t offset = static_cast<unsigned char>(input[pos]) | (static_cast<size_t>(static_cast<unsigned char>(input[pos + 1])) << 8);
+        pos += 2;
+        if (!readLength(token & 0x0f, match) || offset == 0 || offset > written)
+        {
+            return false;
+        }
+        match += lzMinMatch;
+        if (match > originalSize - written)
+        {
+            return false;
+        }
+        // La coincidencia puede solaparse con lo que se está copiando (repeticiones)
+        const char *from = out + written - offset;
+        if (offset >= match)
+        {
+            std::memcpy(out + written, from, match);
+        }
+        else
+        {
+            for (size_t i = 0; i < match; ++i)
+            {
+                out[written + i] = from[i];
+            }
+        }
+        written += match;
+    }
+    return written == originalSize;
+}
+
+// Área de bytes donde se empaquetan extensiones de tamaño variable. Los huecos que dejan
+// las extensiones liberadas se juntan con los vecinos y se reutilizan con el que mejor
+// se ajuste; si el hueco queda al final, el área se acorta.
+class ExtentArena
+{
+public:
+    size_t allocate(size_t length)
+    {
+        auto hole = holesBySize.lower_bound({length, 0});
+        if (hole == holesBySize.end())
+        {
+            size_t offset = bytes.size();
+            bytes.resize(offset + length);
+            return offset;
+        }
+
+        size_t offset = hole->second;
+        size_t holeLength = hole->first;
+        holesBySize.erase(hole);
+        holes.erase(offset);
+        holeBytes -= holeLength;
+        if (holeLength > length)
+        {
+            addHole(offset + length, holeLength - length);
+        }
+        return offset;
+    }
+
+    void release(size_t offset, size_t length)
+    {
+        // Juntar con el hueco siguiente y con el anterior
+        auto next = holes.find(offset + length);
+        if (next != holes.end())
+        {
+            length += next->second;
+            removeHole(next);
+        }
+        auto previous = holes.lower_bound(offset);
+        if (previous != holes.begin() && (--previous)->first + previous->second == offset)
+        {
+            offset = previous->first;
+            length += previous->second;
+            removeHole(previous);
+        }
+
+        if (offset + length == bytes.size())
+        {
+            bytes.resize(offset);
+        }
+        else
+        {
+            addHole(offset, length);
+        }
+    }
+
+    char *at(size_t offset)
+    {
+        return bytes.data() + offset;
+    }
+
+    const char *at(size_t offset) const
+    {
+        return bytes.data() + offset;
+    }
+
+    size_t size() const
+    {
+        return bytes.size();
+    }
+
+    size_t freeBytes() const
+    {
+        return holeBytes;
+    }
+
+    size_t holeCount() const
+    {
+        return holes.size();
+    }
+
+    void clear()
+    {
+        bytes.clear();
+        bytes.shrink_to_fit();
+        holes.clear();
+        holesBySize.clear();
+        holeBytes = 0;
+    }
+
+private:
+    void addHole(size_t offset, size_t length)
+    {
+        holes[offset] = length;
+        holesBySize.insert({length, offset});
+        holeBytes += length;
+    }
+
+    void removeHole(std::map<size_t, size_t>::iterator hole)
+    {
+        holesBySize.erase({hole->second, hole->first});
+        holeBytes -= hole->second;
+        holes.erase(hole);
+    }
+
+    std::vector<char> bytes;
+    std::map<size_t, size_t> holes;                 // Desplazamiento → longitud
+    std::set<std::pair<size_t, size_t>> holesBySize; // (longitud, desplazamiento)
+    size_t holeBytes = 0;
+};
+
+// Estadísticas del compresor de Swap
+struct SwapCompressionStats
+{
+    std::atomic<long long> compressions{0};
+    std::atomic<long long> incompressible{0}; // Páginas que no se reducían y se guardaron tal cual
+    std::atomic<long long> decompressions{0};
+    std::atomic<long long> compress_ns{0};
+    std::atomic<long long> decompress_ns{0};
+};
+
+SwapCompressionStats swapCompressionStats;
+
+// Contenido de los frames de Swap comprimido y empaquetado en un área común: cada frame
+// apunta a su extensión (desplazamiento, longitud comprimida y tamaño original). La
+// compresión y la descompresión se hacen fuera del lock; dentro solo se copian bytes.
+class CompressedSwapStore
+{
+public:
+    // Vacía el área y deja una extensión vacía por frame
+    void reset(size_t frames)
+    {
+        std::lock_guard<std::mutex> storeLock(mutex);
+        arena.clear();
+        extents.assign(frames, {});
+        storedBytes = 0;
+        originalBytes = 0;
+    }
+
+    void store(int frame_number, std::string_view content)
+    {
+        std::string packed;
+        bool compressed = false;
+        if (!content.empty())
+        {
+            auto start = std::chrono::steady_clock::now();
+            packed = lzCompress(content);
+            swapCompressionStats.compress_ns += elapsedNs(start);
+            swapCompressionStats.compressions++;
+            compressed = packed.size() < content.size();
+            if (!compressed)
+            {
+                swapCompressionStats.incompressible++;
+                packed.assign(content);
+            }
+        }
+
+        std::lock_guard<std::mutex> storeLock(mutex);
+        Extent &extent = extents[frame_number];
+        releaseLocked(extent);
+        if (!packed.empty())
+        {
+            extent = {arena.allocate(packed.size()), packed.size(), content.size(), compressed};
+            std::memcpy(arena.at(extent.offset), packed.data(), packed.size());
+            storedBytes += extent.length;
+            originalBytes += extent.original;
+        }
+    }
+
+    // Copia en content el contenido del frame. Devuelve false, con content vacío, si el
+    // bloque comprimido está dañado.
+    bool load(int frame_number, std::string &content) const
+    {
+        Extent extent;
+        std::string packed;
+        {
+            std::lock_guard<std::mutex> storeLock(mutex);
+            extent = extents[frame_number];
+            if (extent.length > 0)
+            {
+                packed.assign(arena.at(extent.offset), extent.length);
+            }
+        }
+        if (!extent.compressed)
+        {
+            content = std::move(packed);
+            return true;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool decoded = lzDecompress(packed, extent.original, content);
+        swapCompressionStats.decompress_ns += elapsedNs(start);
+        swapCompressionStats.decompressions++;
+        if (!decoded)
+        {
+            std::cerr << "Contenido comprimido dañado en el frame de Swap " << frame_number << std::endl;
+            content.clear();
+        }
+        return decoded;
+    }
+
+    size_t originalSize(int frame_number) const
+    {
+        std::lock_guard<std::mutex> storeLock(mutex);
+        return extents[frame_number].original;
+    }
+
+    void erase(int frame_number)
+    {
+        std::lock_guard<std::mutex> storeLock(mutex);
+        releaseLocked(extents[frame_number]);
+    }
+
+    // Bytes originales, bytes guardados, tamaño del área y bytes en huecos
+    void usage(size_t &original, size_t &stored, size_t &arenaBytes, size_t &freeBytes, size_t &holes) const
+    {
+        std::lock_guard<std::mutex> storeLock(mutex);
+        original = originalBytes;
+        stored = storedBytes;
+        arenaBytes = arena.size();
+        freeBytes = arena.freeBytes();
+        holes = arena.holeCount();
+    }
+
+private:
+    struct Extent
+    {
+        size_t offset = 0;
+        size_t length = 0;   // Bytes en el área
+        size_t original = 0; // Bytes del contenido sin comprimir
+        bool compressed = false;
+    };
+
+    static long long elapsedNs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void releaseLocked(Extent &extent)
+    {
+        if (extent.length > 0)
+        {
+            arena.release(extent.offset, extent.length);
+            storedBytes -= extent.length;
+            originalBytes -= extent.original;
+        }
+        extent = {};
+    }
+
+    mutable std::mutex mutex;
+    ExtentArena arena;
+    std::vector<Extent> extents;
+    size_t storedBytes = 0;
+    size_t originalBytes = 0;
+};
+
+CompressedSwapStore compressedSwapStore;
+
+// Si está activo, el contenido de los frames de Swap vive comprimido en compressedSwapStore
+// y Frame::content queda vacío. Solo cambia con imageMutex en modo exclusivo.
+bool compressedSwap = false;
+
+// Copia en content el contenido del frame en el Swap propiamente dicho (en la región si
+// la imagen es compartida), descomprimido si hace falta. Devuelve false si no se puede
+// descomprimir.
+bool readSwapBacking(int frame_number, std::string &content)
+{
+    if (sharedImage.attached())
+    {
+        content.assign(sharedImage.swapContent(frame_number));
+        return true;
+    }
+    if (compressedSwap)
+    {
+        return compressedSwapStore.load(frame_number, content);
+    }
+    content = swapFrames[frame_number].content;
+    return true;
+}
+
+// Como readSwapBacking; un frame dañado se lee vacío
+std::string swapBackingContent(int frame_number)
+{
+    std::string content;
+    readSwapBacking(frame_number, content);
+    return content;
+}
+
+size_t swapBackingSize(int frame_number)
+{
+    if (sharedImage.attached())
+    {
+        return sharedImage.swapContent(frame_number).size();
+    }
+    return compressedSwap ? compressedSwapStore.originalSize(frame_number) : swapFrames[frame_number].content.size();
+}
+
+void writeSwapBacking(int frame_number, std::string_view content)
+{
+    if (sharedImage.attached())
+    {
+        sharedImage.setSwapContent(frame_number, content);
+    }
+    else if (compressedSwap)
+    {
+        compressedSwapStore.store(frame_number, content);
+    }
+    else
+    {
+        swapFrames[frame_number].content = std::string(content);
+    }
+}
+
+// Estadísticas de la caché comprimida de páginas
+struct PageCacheStats
+{
+    std::atomic<long long> hits{0};       // Fallos atendidos desde la caché
+    std::atomic<long long> misses{0};     // Fallos que tuvieron que leer el Swap
+    std::atomic<long long> stores{0};     // Páginas desalojadas que se comprimieron en la caché
+    std::atomic<long long> incompressible{0}; // Páginas que no se reducían y se guardaron tal cual
+    std::atomic<long long> writebacks{0}; // Entradas sucias escritas en Swap al salir por LRU
+    std::atomic<long long> discards{0};   // Entradas limpias que salieron por LRU
+    std::atomic<long long> corrupted{0};  // Entradas que no se pudieron descomprimir
+    std::atomic<long long> compress_ns{0};
+    std::atomic<long long> decompress_ns{0};
+};
+
+PageCacheStats pageCacheStats;
+
+// Caché comprimida en RAM entre los frames de RAM y el Swap (como zswap en Linux): las
+// páginas desalojadas se comprimen aquí y un fallo que encuentra su página la descomprime
+// sin leer el Swap. Las entradas se indexan por frame de Swap. Una entrada sucia es más
+// reciente que su frame de Swap y se escribe en él cuando sale de la caché; salen por LRU
+// cuando los bytes comprimidos pasan del límite. El lock de la caché va después de los de
+// los procesos y antes del de compressedSwapStore.
+class CompressedPageCache
+{
+public:
+    // Cambia el límite de bytes comprimidos; con 0 la caché se vacía y queda apagada
+    void configure(size_t maxBytes)
+    {
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        capacity = maxBytes;
+        shrinkLocked();
+    }
+
+    bool enabled() const
+    {
+        return capacity.load(std::memory_order_relaxed) > 0;
+    }
+
+    // Guarda una página desalojada; las que no se reducen se guardan sin comprimir, así
+    // tampoco hace falta leer el Swap para recuperarlas. Devuelve false si la caché está
+    // apagada: entonces, si la página está sucia, quien llama la escribe en Swap.
+    bool store(int frame_number, std::string_view content, bool dirty)
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+        if (!dirty)
+        {
+            // Una página limpia coincide con lo que ya haya en la caché para su frame
+            std::lock_guard<std::mutex> cacheLock(mutex);
+            auto entry = entries.find(frame_number);
+            if (entry != entries.end())
+            {
+                lru.splice(lru.begin(), lru, entry->second.position);
+                return true;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::string packed = lzCompress(content);
+        pageCacheStats.compress_ns += elapsedNs(start);
+        bool compressed = packed.size() < content.size();
+        if (!compressed)
+        {
+            pageCacheStats.incompressible++;
+            packed.assign(content);
+        }
+
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        auto entry = entries.find(frame_number);
+        if (entry != entries.end())
+        {
+            dirty = dirty || entry->second.dirty;
+            eraseLocked(entry);
+        }
+        if (packed.empty())
+        {
+            return false;
+        }
+
+        lru.push_front(frame_number);
+        Entry &added = entries[frame_number];
+        added = {arena.allocate(packed.size()), packed.size(), content.size(), compressed, dirty, lru.begin()};
+        std::memcpy(arena.at(added.offset), packed.data(), packed.size());
+        storedBytes += added.length;
+        originalBytes += added.original;
+        pageCacheStats.stores++;
+        shrinkLocked();
+        return true;
+    }
+
+    // Copia en content la página del frame si está en la caché
+    bool load(int frame_number, std::string &content)
+    {
+        size_t original;
+        std::string packed;
+        {
+            std::lock_guard<std::mutex> cacheLock(mutex);
+            auto entry = entries.find(frame_number);
+            if (entry == entries.end())
+            {
+                return false;
+            }
+            lru.splice(lru.begin(), lru, entry->second.position);
+            original = entry->second.original;
+            packed.assign(arena.at(entry->second.offset), entry->second.length);
+            if (!entry->second.compressed)
+            {
+                content = std::move(packed);
+                return true;
+            }
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        bool decoded = lzDecompress(packed, original, content);
+        pageCacheStats.decompress_ns += elapsedNs(start);
+        if (!decoded)
+        {
+            std::cerr << "Contenido dañado en la caché comprimida para el frame de Swap " << frame_number << std::endl;
+            pageCacheStats.corrupted++;
+            content.clear();
+            return false; // Quien llama lee el frame del Swap
+        }
+        return true;
+    }
+
+    bool originalSize(int frame_number, size_t &size) const
+    {
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        auto entry = entries.find(frame_number);
+        if (entry == entries.end())
+        {
+            return false;
+        }
+        size = entry->second.original;
+        return true;
+    }
+
+    // Descarta la entrada del frame (su contenido se sustituye o se libera)
+    void erase(int frame_number)
+    {
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        auto entry = entries.find(frame_number);
+        if (entry != entries.end())
+        {
+            eraseLocked(entry);
+        }
+    }
+
+    // Descarta todas las entradas sin escribirlas: la imagen se vuelve a cargar
+    void clear()
+    {
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        entries.clear();
+        lru.clear();
+        arena.clear();
+        storedBytes = 0;
+        originalBytes = 0;
+    }
+
+    // Entradas, entradas sucias, bytes originales, bytes comprimidos y límite
+    void usage(size_t &count, size_t &dirty, size_t &original, size_t &stored, size_t &maxBytes) const
+    {
+        std::lock_guard<std::mutex> cacheLock(mutex);
+        count = entries.size();
+        dirty = 0;
+        for (const auto &entry : entries)
+        {
+            dirty += entry.second.dirty ? 1 : 0;
+        }
+        original = originalBytes;
+        stored = storedBytes;
+        maxBytes = capacity;
+    }
+
+private:
+    struct Entry
+    {
+        size_t offset;
+        size_t length;
+        size_t original;
+        bool compressed;
+        bool dirty;
+        std::list<int>::iterator position; // Posición en lru
+    };
+
+    static long long elapsedNs(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void eraseLocked(std::unordered_map<int, Entry>::iterator entry)
+    {
+        arena.release(entry->second.offset, entry->second.length);
+        storedBytes -= entry->second.length;
+        originalBytes -= entry->second.original;
+        lru.erase(entry->second.position);
+        entries.erase(entry);
+    }
+
+    // Saca las entradas menos usadas hasta quedar dentro del límite. Una entrada sucia que
+    // no se puede descomprimir no se escribe: el Swap conserva la última copia buena.
+    void shrinkLocked()
+    {
+        while (storedBytes > capacity && !lru.empty())
+        {
+            auto entry = entries.find(lru.back());
+            if (entry->second.dirty)
+            {
+                std::string content(arena.at(entry->second.offset), entry->second.length);
+                if (entry->second.compressed &&
+                    !lzDecompress(std::string_view(arena.at(entry->second.offset), entry->second.length),
+                                  entry->second.original, content))
+                {
+                    std::cerr << "Contenido dañado en la caché comprimida para el frame de Swap " << entry->first
+                              << "; no se escribe en Swap" << std::endl;
+                    pageCacheStats.corrupted++;
+                    eraseLocked(entry);
+                    continue;
+                }
+                writeSwapBacking(entry->first, content);
+                evictionStats.bytes_written_back += content.size();
+                swapImageModified = true;
+                pageCacheStats.writebacks++;
+            }
+            else
+            {
+                pageCacheStats.discards++;
+            }
+            eraseLocked(entry);
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::atomic<size_t> capacity{0};
+    ExtentArena arena;
+    std::unordered_map<int, Entry> entries;
+    std::list<int> lru; // Frames de Swap, del más reciente al menos usado
+    size_t storedBytes = 0;
+    size_t originalBytes = 0;
+};
+
+CompressedPageCache compressedPageCache;
+
+// Contenido de un frame de Swap: el de la caché comprimida si la página está allí, que es
+// el más reciente, o el del Swap
+std::string swapPageContent(int frame_number)
+{
+    std::string content;
+    if (compressedPageCache.enabled() && compressedPageCache.load(frame_number, content))
+    {
+        return content;
+    }
+    return swapBackingContent(frame_number);
+}
+
+size_t swapPageSize(int frame_number)
+{
+    size_t size;
+    if (compressedPageCache.enabled() && compressedPageCache.originalSize(frame_number, size))
+    {
+        return size;
+    }
+    return swapBackingSize(frame_number);
+}
+
+// Escribe el contenido de un frame de Swap; con contenido vacío lo limpia. La entrada
+// de la caché comprimida, si había, queda obsoleta y se descarta.
+void setSwapPageContent(int frame_number, std::string_view content)
+{
+    if (compressedPageCache.enabled())
+    {
+        compressedPageCache.erase(frame_number);
+    }
+    writeSwapBacking(frame_number, content);
+}
+
+// Pasa el contenido de los frames de Swap recién cargados al almacén comprimido.
+// El llamador tiene imageMutex en modo exclusivo.
+void packSwapFramesLocked()
+{
+    compressedSwapStore.reset(compressedSwap ? swapFrames.size() : 0);
+    if (!compressedSwap)
+    {
+        return;
+    }
+    for (auto &frame : swapFrames)
+    {
+        if (!frame.content.empty())
+        {
+            compressedSwapStore.store(frame.frame_number, frame.content);
+            std::string().swap(frame.content);
+        }
+    }
+}
+
+// Bitmap de frames libres sin locks: un bit a 1 por frame libre. Reservar un frame es
+// apagar su bit con compare-and-swap y liberarlo es volver a encenderlo.
+class AtomicFrameBitmap
+{
+public:
+    // Reconstruye el bitmap a partir de los frames [first, first + count). Los bits se
+    // numeran desde first. No debe haber reservas en curso.
+    void reset(const std::vector<Frame> &frames, size_t first = 0, size_t count = SIZE_MAX)
+    {
+        first = std::min(first, frames.size());
+        numFrames = std::min(count, frames.size() - first);
+        numWords = (numFrames + 63) / 64;
+        owned.reset(new std::atomic<uint64_t>[std::max<size_t>(numWords, 1)]);
+        words = owned.get();
+        for (size_t i = 0; i < numWords; ++i)
+        {
+            words[i].store(0, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < numFrames; ++i)
+        {
+            if (frames[first + i].is_free)
+            {
+                words[i / 64].fetch_or(uint64_t(1) << (i % 64), std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Usa como bitmap los count primeros bits de external, que son de otro (la imagen
+    // compartida) y conservan su contenido
+    void attach(std::atomic<uint64_t> *external, size_t count)
+    {
+        owned.reset();
+        words = external;
+        numFrames = count;
+        numWords = (count + 63) / 64;
+    }
+
+    // Reserva un frame libre empezando a buscar en la palabra hint. Devuelve -1 si no hay ninguno.
+    int claim(size_t &hint)
+    {
+        for (size_t n = 0; n < numWords; ++n)
+        {
+            size_t i = (hint + n) % numWords;
+            uint64_t word = words[i].load(std::memory_order_relaxed);
+            while (word != 0)
+            {
+                int bit = __builtin_ctzll(word);
+                if (words[i].compare_exchange_weak(word, word & ~(uint64_t(1) << bit),
+                                                   std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    hint = i;
+                    return static_cast<int>(i * 64 + bit);
+                }
+            }
+        }
+        return -1;
+    }
+
+    // Devuelve un frame al bitmap; lo escrito antes en el frame queda visible para el próximo dueño
+    void release(int frame_number)
+    {
+        words[frame_number / 64].fetch_or(uint64_t(1) << (frame_number % 64), std::memory_order_release);
+    }
+
+    // Reserva span frames seguidos (span <= 64) dentro de una misma palabra, para una
+    // página grande. Devuelve el primero o -1 si ninguna palabra tiene un tramo tan largo.
+    int claimRun(size_t span, size_t &hint)
+    {
+        for (size_t n = 0; n < numWords; ++n)
+        {
+            size_t i = (hint + n) % numWords;
+            uint64_t word = words[i].load(std::memory_order_relaxed);
+            while (true)
+            {
+                // Bits donde empieza un tramo de span bits a 1
+                uint64_t starts = word;
+                for (size_t k = 1; k < span && starts != 0; ++k)
+                {
+                    starts &= word >> k;
+                }
+                if (starts == 0)
+                {
+                    break;
+                }
+                int bit = __builtin_ctzll(starts);
+                if (words[i].compare_exchange_weak(word, word & ~(runMask(span) << bit),
+                                                   std::memory_order_acquire, std::memory_order_relaxed))
+                {
+                    hint = i;
+                    return static_cast<int>(i * 64 + bit);
+                }
+            }
+        }
+        return -1;
+    }
+
+    void releaseRun(int frame_number, size_t span)
+    {
+        words[frame_number / 64].fetch_or(runMask(span) << (frame_number % 64), std::memory_order_release);
+    }
+
+    size_t freeCount() const
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < numWords; ++i)
+        {
+            count += __builtin_popcountll(words[i].load(std::memory_order_relaxed));
+        }
+        return count;
+    }
+
+    size_t size() const { return numFrames; }
+
+private:
+    static uint64_t runMask(size_t span)
+    {
+        return span >= 64 ? ~uint64_t(0) : (uint64_t(1) << span) - 1;
+    }
+
+    std::unique_ptr<std::atomic<uint64_t>[]> owned;
+    std::atomic<uint64_t> *words = nullptr;
+    size_t numWords = 0;
+    size_t numFrames = 0;
+};
+
+// Palabra del bitmap donde cada hilo empieza a buscar; hilos distintos empiezan en
+// zonas distintas para no competir por la misma palabra
+size_t &allocatorHint()
+{
+    static std::atomic<size_t> threads{0};
+    thread_local size_t hint = threads++ * 8;
+    return hint;
+}
+
+// Cargador (magazine) de frames libres de un hilo. Solo su hilo toca la lista de
+// frames; los demás hilos únicamente piden que la vacíe con reclaimRequested.
+struct FrameMagazine
+{
+    std::vector<int> frames;
+    std::atomic<size_t> count{0};
+    std::atomic<bool> reclaimRequested{false};
+    std::atomic<unsigned long long> last_use_tick{0};
+    std::atomic<AtomicFrameBitmap *> bitmap{nullptr};
+    const std::atomic<unsigned> *poolGeneration = nullptr; // Generación actual de su pool
+    unsigned generation = 0;
+
+    // Devuelve todos sus frames al bitmap (solo desde el hilo dueño). Si el bitmap se
+    // reconstruyó desde que los tomó, sus frames ya no son suyos y se descartan.
+    void flush()
+    {
+        AtomicFrameBitmap *target = bitmap.load(std::memory_order_acquire);
+        if (target != nullptr && generation == poolGeneration->load(std::memory_order_acquire))
+        {
+            for (int frame_number : frames)
+            {
+                target->release(frame_number);
+            }
+        }
+        frames.clear();
+        count.store(0, std::memory_order_relaxed);
+        reclaimRequested.store(false, std::memory_order_relaxed);
+    }
+};
+
+// Magazines del hilo actual; al terminar el hilo se devuelven sus frames
+struct ThreadMagazines
+{
+    std::vector<std::shared_ptr<FrameMagazine>> magazines;
+
+    ~ThreadMagazines()
+    {
+        for (auto &magazine : magazines)
+        {
+            if (magazine)
+            {
+                magazine->flush();
+            }
+        }
+    }
+};
+
+// Pool de frames con un magazine por hilo delante del bitmap global. Los frames se
+// reservan y devuelven al bitmap por lotes, así el caso común no usa instrucciones
+// atómicas de lectura-modificación-escritura ni toca líneas de caché compartidas.
+// Si el bitmap se queda sin frames se pide a los demás hilos que vacíen sus magazines.
+class MagazinePool
+{
+public:
+    static const size_t CAPACITY = 32; // Frames como máximo en un magazine
+    static const size_t BATCH = 16;    // Frames que se mueven en cada recarga o vaciado
+
+    explicit MagazinePool(AtomicFrameBitmap &bitmap) : bitmap(bitmap), id(nextId++) {}
+
+    ~MagazinePool()
+    {
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        for (const auto &magazine : magazines)
+        {
+            magazine->bitmap.store(nullptr, std::memory_order_release);
+        }
+    }
+
+    // Reserva un frame. Con reclaim = false no se piden frames a otros hilos si el bitmap está vacío.
+    int allocate(bool reclaim = true)
+    {
+        FrameMagazine &magazine = local();
+        if (magazine.frames.empty())
+        {
+            refill(magazine);
+        }
+        if (!magazine.frames.empty())
+        {
+            int frame_number = magazine.frames.back();
+            magazine.frames.pop_back();
+            magazine.count.store(magazine.frames.size(), std::memory_order_relaxed);
+            return frame_number;
+        }
+        if (!reclaim)
+        {
+            return -1;
+        }
+
+        // Presión global: pedir a los demás hilos que devuelvan sus frames y reintentar
+        requestReclaim(0);
+        for (int attempt = 0; attempt < 3; ++attempt)
+        {
+            int frame_number = bitmap.claim(allocatorHint());
+            if (frame_number != -1)
+            {
+                return frame_number;
+            }
+            std::this_thread::yield();
+        }
+        return -1;
+    }
+
+    // Reserva span frames seguidos directamente del bitmap: los magazines solo guardan
+    // frames sueltos. Si no hay tramo libre, los frames de los magazines pueden completarlo.
+    int allocateRun(size_t span, bool reclaim = true)
+    {
+        int frame_number = bitmap.claimRun(span, allocatorHint());
+        if (frame_number != -1 || !reclaim)
+        {
+            return frame_number;
+        }
+
+        local().flush();
+        requestReclaim(0);
+        for (int attempt = 0; attempt < 3; ++attempt)
+        {
+            frame_number = bitmap.claimRun(span, allocatorHint());
+            if (frame_number != -1)
+            {
+                return frame_number;
+            }
+            std::this_thread::yield();
+        }
+        return -1;
+    }
+
+    void releaseRun(int frame_number, size_t span)
+    {
+        bitmap.releaseRun(frame_number, span);
+    }
+
+    void release(int frame_number)
+    {
+        FrameMagazine &magazine = local();
+        magazine.frames.push_back(frame_number);
+        if (magazine.frames.size() > CAPACITY)
+        {
+            for (size_t i = 0; i < BATCH; ++i)
+            {
+                bitmap.release(magazine.frames.back());
+                magazine.frames.pop_back();
+            }
+        }
+        magazine.count.store(magazine.frames.size(), std::memory_order_relaxed);
+    }
+
+    // Frames libres en el bitmap y en todos los magazines (aproximado si hay hilos trabajando)
+    size_t available()
+    {
+        size_t total = bitmap.freeCount();
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        for (const auto &magazine : magazines)
+        {
+            total += magazine->count.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Lo llama un hilo antes de quedarse inactivo: devuelve su magazine al bitmap
+    void flushLocal()
+    {
+        local().flush();
+    }
+
+    // Pide que se vacíen los magazines que no se usaron en las últimas idleTicks llamadas
+    // (0 = todos). Cada hilo lo atiende en su siguiente reserva o liberación.
+    void requestReclaim(unsigned long long idleTicks = 1)
+    {
+        unsigned long long now = ++tick;
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        for (const auto &magazine : magazines)
+        {
+            if (idleTicks == 0 || magazine->last_use_tick.load(std::memory_order_relaxed) + idleTicks < now)
+            {
+                magazine->reclaimRequested.store(true, std::memory_order_relaxed);
+            }
+        }
+        // Los hilos que ya terminaron vaciaron su magazine al salir
+        magazines.erase(std::remove_if(magazines.begin(), magazines.end(),
+                                       [](const std::shared_ptr<FrameMagazine> &magazine)
+                                       { return magazine.use_count() == 1; }),
+                        magazines.end());
+    }
+
+    // Descarta el contenido de todos los magazines sin devolverlo (el bitmap se reconstruyó)
+    void invalidate()
+    {
+        generation.fetch_add(1, std::memory_order_release);
+    }
+
+private:
+    FrameMagazine &local()
+    {
+        thread_local ThreadMagazines threadMagazines;
+        auto &list = threadMagazines.magazines;
+        if (list.size() <= id)
+        {
+            list.resize(id + 1);
+        }
+        auto &magazine = list[id];
+        if (!magazine)
+        {
+            magazine = std::make_shared<FrameMagazine>();
+            magazine->frames.reserve(CAPACITY + 1);
+            magazine->bitmap.store(&bitmap, std::memory_order_relaxed);
+            magazine->poolGeneration = &generation;
+            magazine->generation = generation.load(std::memory_order_relaxed);
+            std::lock_guard<std::mutex> registryLock(registryMutex);
+            magazines.push_back(magazine);
+        }
+
+        unsigned current = generation.load(std::memory_order_relaxed);
+        if (magazine->generation != current)
+        {
+            magazine->frames.clear();
+            magazine->count.store(0, std::memory_order_relaxed);
+            magazine->generation = current;
+        }
+        if (magazine->reclaimRequested.load(std::memory_order_relaxed))
+        {
+            magazine->flush();
+        }
+        magazine->last_use_tick.store(tick.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *magazine;
+    }
+
+    void refill(FrameMagazine &magazine)
+    {
+        size_t &hint = allocatorHint();
+        for (size_t i = 0; i < BATCH; ++i)
+        {
+            int frame_number = bitmap.claim(hint);
+            if (frame_number == -1)
+            {
+                break;
+            }
+            magazine.frames.push_back(frame_number);
+        }
+        // Se sacan por el final: así se entregan en orden ascendente
+        std::reverse(magazine.frames.begin(), magazine.frames.end());
+    }
+
+    AtomicFrameBitmap &bitmap;
+    size_t id;
+    std::mutex registryMutex;
+    std::vector<std::shared_ptr<FrameMagazine>> magazines;
+    std::atomic<unsigned> generation{0};
+    std::atomic<unsigned long long> tick{0};
+    static inline std::atomic<size_t> nextId{0};
+};
+
+// Parte de una tabla de frames con sus propias estructuras de frames libres
+struct FrameShard
+{
+    int first_frame; // Número del primer frame del shard
+    int frame_count;
+    AtomicFrameBitmap bitmap;
+    MagazinePool magazines{bitmap};
+    std::atomic<long long> steals{0}; // Frames que otros procesos tomaron de este shard
+};
+
+// Tabla de frames dividida en shards independientes. Cada proceso tiene un shard propio
+// (process_id % shards) y solo si se agota toma frames de los demás, así procesos con
+// shards distintos no comparten estructuras al reservar.
+class ShardedFramePool
+{
+public:
+    // Reparte los frames en el número de shards indicado. No debe haber reservas en curso.
+    void reset(const std::vector<Frame> &frames, size_t shardCount)
+    {
+        shardCount = std::max<size_t>(1, std::min(shardCount, std::max<size_t>(frames.size(), 1)));
+        if (shards.size() != shardCount)
+        {
+            shards.clear();
+            for (size_t i = 0; i < shardCount; ++i)
+            {
+                shards.push_back(std::make_unique<FrameShard>());
+            }
+        }
+
+        shardSize = std::max<size_t>((frames.size() + shardCount - 1) / shardCount, 1);
+        for (size_t i = 0; i < shardCount; ++i)
+        {
+            FrameShard &shard = *shards[i];
+            shard.first_frame = static_cast<int>(std::min(i * shardSize, frames.size()));
+            shard.frame_count = static_cast<int>(std::min(shardSize, frames.size() - shard.first_frame));
+            shard.bitmap.reset(frames, shard.first_frame, shard.frame_count);
+            shard.magazines.invalidate();
+            shard.steals = 0;
+        }
+        direct = false;
+    }
+
+    // Reparte en shards el bitmap de otro (el de la imagen compartida) en vez de construir
+    // uno. Cada shard empieza en una palabra y sus reservas van directas al bitmap: los
+    // frames guardados en un magazine no los vería ningún otro proceso.
+    void attach(std::atomic<uint64_t> *words, size_t frameCount, size_t shardCount)
+    {
+        // Al redondear el tamaño a palabras enteras sobran shards si hay pocos frames: solo
+        // se crean los que reciben alguno
+        shardCount = std::max<size_t>(1, std::min(shardCount, (frameCount + 63) / 64));
+        shardSize = std::max<size_t>(((frameCount + shardCount - 1) / shardCount + 63) / 64 * 64, 64);
+        shardCount = std::max<size_t>(1, (frameCount + shardSize - 1) / shardSize);
+        if (shards.size() != shardCount)
+        {
+            shards.clear();
+            for (size_t i = 0; i < shardCount; ++i)
+            {
+                shards.push_back(std::make_unique<FrameShard>());
+            }
+        }
+
+        for (size_t i = 0; i < shardCount; ++i)
+        {
+            FrameShard &shard = *shards[i];
+            shard.first_frame = static_cast<int>(std::min(i * shardSize, frameCount));
+            shard.frame_count = static_cast<int>(std::min(shardSize, frameCount - shard.first_frame));
+            shard.bitmap.attach(words + shard.first_frame / 64, shard.frame_count);
+            shard.magazines.invalidate();
+            shard.steals = 0;
+        }
+        direct = true;
+    }
+
+    size_t homeShard(int process_id) const
+    {
+        return static_cast<size_t>(process_id < 0 ? -process_id : process_id) % shards.size();
+    }
+
+    // Reserva un frame (o span frames seguidos para una página grande) para el proceso:
+    // primero en su shard y, si está agotado, en los demás
+    int allocate(int process_id, size_t span = 1)
+    {
+        if (shards.empty())
+        {
+            return -1;
+        }
+
+        size_t home = homeShard(process_id);
+        for (bool reclaim : {false, true})
+        {
+            for (size_t n = 0; n < shards.size(); ++n)
+            {
+                FrameShard &shard = *shards[(home + n) % shards.size()];
+                int local;
+                if (direct)
+                {
+                    local = span == 1 ? shard.bitmap.claim(allocatorHint()) : shard.bitmap.claimRun(span, allocatorHint());
+                }
+                else
+                {
+                    local = span == 1 ? shard.magazines.allocate(reclaim) : shard.magazines.allocateRun(span, reclaim);
+                }
+                if (local != -1)
+                {
+                    if (n != 0)
+                    {
+                        shard.steals++;
+                    }
+                    return shard.first_frame + local;
+                }
+            }
+        }
+        return -1;
+    }
+
+    void release(int frame_number, size_t span = 1)
+    {
+        FrameShard &shard = *shards[frame_number / shardSize];
+        if (direct)
+        {
+            shard.bitmap.releaseRun(frame_number - shard.first_frame, span);
+        }
+        else if (span == 1)
+        {
+            shard.magazines.release(frame_number - shard.first_frame);
+        }
+        else
+        {
+            shard.magazines.releaseRun(frame_number - shard.first_frame, span);
+        }
+    }
+
+    size_t available()
+    {
+        size_t total = 0;
+        for (auto &shard : shards)
+        {
+            total += shard->magazines.available();
+        }
+        return total;
+    }
+
+    // Pide a los hilos que vacíen los magazines inactivos de todos los shards
+    void requestReclaim(unsigned long long idleTicks = 1)
+    {
+        for (auto &shard : shards)
+        {
+            shard->magazines.requestReclaim(idleTicks);
+        }
+    }
+
+    void flushLocal()
+    {
+        for (auto &shard : shards)
+        {
+            shard->magazines.flushLocal();
+        }
+    }
+
+    const std::vector<std::unique_ptr<FrameShard>> &getShards() const { return shards; }
+
+private:
+    std::vector<std::unique_ptr<FrameShard>> shards;
+    size_t shardSize = 1;
+    bool direct = false; // Sin magazines: el bitmap es de la imagen compartida
+};
+
+// Número de shards de las tablas de RAM y Swap (se aplica al cargar la imagen)
+size_t frameShards = 4;
+ShardedFramePool ramPool;
+ShardedFramePool swapPool;
+
+// Devuelve los frames de los magazines del hilo actual, con imageMutex en modo compartido
+// para que nadie reconstruya los pools a la vez. Lo llaman los hilos de trabajo antes de
+// quedarse inactivos.
+void flushThreadMagazines()
+{
+    std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+    ramPool.flushLocal();
+    swapPool.flushLocal();
+}
+
+std::vector<Frame> framesFromJson(const json &j)
+{
+    std::vector<Frame> frames;
+    for (const auto &item : j["frames"])
+    {
+        frames.push_back({item["content"].get<std::string>(),
+                          item["frame_number"].get<int>(),
+                          item["is_free"].get<bool>(),
+                          item["page_number"].get<int>(),
+                          item["process_id"].get<int>(),
+                          item["segment_id"].get<int>(),
+                          item.value("pin_count", 0),
+                          item.value("span", 1)});
+    }
+
+    return frames;
+}
+
+std::vector<Frame> loadFramesFromJson(const std::string &filename)
+{
+    std::ifstream file(filename);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("No se pudo abrir el archivo JSON");
+    }
+
+    json j;
+    file >> j;
+
+    return framesFromJson(j);
+}
+
+// contentOf, si se indica, da el contenido de cada frame (el de Swap puede estar comprimido)
+json framesToJson(const std::vector<Frame> &frames, bool withPinCount, std::string (*contentOf)(int) = nullptr)
+{
+    json array = json::array();
+    for (const auto &frame : frames)
+    {
+        json item;
+        item["content"] = contentOf ? contentOf(frame.frame_number) : frame.content;
+        item["frame_number"] = frame.frame_number;
+        item["is_free"] = frame.is_free;
+        item["page_number"] = frame.page_number;
+        item["process_id"] = frame.process_id;
+        item["segment_id"] = frame.segment_id;
+        if (withPinCount)
+        {
+            item["pin_count"] = frame.pin_count;
+        }
+        if (frame.span != 1)
+        {
+            item["span"] = frame.span;
+        }
+        array.push_back(item);
+    }
+    return array;
+}
+
+// Instantánea inmutable del registro de contadores por process_id. Se publica una nueva
+// cuando aparece un process_id, cuando se libera uno sin frames y al recontar la imagen;
+// los contadores son atómicos y cambian sin publicar. Los de un process_id retirado se
+// borran con su instantánea, cuando ya no la lee nadie.
+struct MemorySnapshot
+{
+    unsigned long long version = 0;
+    std::unordered_map<int, std::shared_ptr<ProcessFrameCounters>> processes;
+};
+
+// Publicación de instantáneas al estilo RCU con épocas. Cada hilo lector anuncia en su
+// ranura la época en la que empezó a leer; el escritor cambia el puntero publicado y
+// solo borra una instantánea retirada cuando ningún lector activo empezó antes de
+// retirarla. Leer son dos cargas y dos escrituras atómicas: no hay locks ni reintentos.
+class SnapshotDomain
+{
+public:
+    ~SnapshotDomain()
+    {
+        delete published.load();
+        for (const auto &retiredSnapshot : retired)
+        {
+            delete retiredSnapshot.first;
+        }
+    }
+
+    // Empieza una lectura y devuelve la instantánea actual (nullptr si aún no hay ninguna).
+    // Las lecturas pueden anidarse en el mismo hilo.
+    const MemorySnapshot *acquire()
+    {
+        LocalReader &reader = localReader();
+        if (reader.depth++ == 0)
+        {
+            reader.slot->epoch.store(epoch.load());
+        }
+        return published.load();
+    }
+
+    void release()
+    {
+        LocalReader &reader = localReader();
+        if (--reader.depth == 0)
+        {
+            reader.slot->epoch.store(0);
+        }
+    }
+
+    // Sustituye la instantánea publicada y libera las retiradas que ya nadie puede leer
+    void publish(std::unique_ptr<MemorySnapshot> snapshot)
+    {
+        const MemorySnapshot *old = published.exchange(snapshot.release());
+        unsigned long long retiredAt = epoch.fetch_add(1);
+
+        std::lock_guard<std::mutex> registryLock(registryMutex);
+        if (old != nullptr)
+        {
+            retired.emplace_back(old, retiredAt);
+        }
+
+        unsigned long long oldestReader = ULLONG_MAX;
+        for (const auto &slot : slots)
+        {
+            unsigned long long readerEpoch = slot.epoch.load();
+            if (readerEpoch != 0)
+            {
+                oldestReader = std::min(oldestReader, readerEpoch);
+            }
+        }
+        while (!retired.empty() && retired.front().second < oldestReader)
+        {
+            delete retired.front().first;
+            retired.pop_front();
+        }
+    }
+
+private:
+    struct ReaderSlot
+    {
+        std::atomic<unsigned long long> epoch{0}; // 0: el hilo no está leyendo
+        bool in_use = false;
+    };
+
+    // Ranura del hilo; al terminar el hilo queda libre para otro
+    struct LocalReader
+    {
+        SnapshotDomain *domain = nullptr;
+        ReaderSlot *slot = nullptr;
+        int depth = 0;
+
+        ~LocalReader()
+        {
+            if (slot != nullptr)
+            {
+                std::lock_guard<std::mutex> registryLock(domain->registryMutex);
+                slot->in_use = false;
+            }
+        }
+    };
+
+    LocalReader &localReader()
+    {
+        thread_local LocalReader reader;
+        if (reader.slot == nullptr)
+        {
+            std::lock_guard<std::mutex> registryLock(registryMutex);
+            for (auto &slot : slots)
+            {
+                if (!slot.in_use)
+                {
+                    reader.slot = &slot;
+                    break;
+                }
+            }
+            if (reader.slot == nullptr)
+            {
+                reader.slot = &slots.emplace_back();
+            }
+            reader.slot->in_use = true;
+            reader.domain = this;
+        }
+        return reader;
+    }
+
+    std::atomic<const MemorySnapshot *> published{nullptr};
+    std::atomic<unsigned long long> epoch{1};
+    std::mutex registryMutex; // Solo para registrar hilos y para el escritor
+    std::deque<ReaderSlot> slots;
+    std::deque<std::pair<const MemorySnapshot *, unsigned long long>> retired;
+};
+
+SnapshotDomain memorySnapshots;
+
+// Lectura de la instantánea publicada mientras el objeto está vivo
+class SnapshotReader
+{
+public:
+    SnapshotReader() : snapshot(memorySnapshots.acquire()) {}
+    ~SnapshotReader() { memorySnapshots.release(); }
+    SnapshotReader(const SnapshotReader &) = delete;
+    SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+    const MemorySnapshot *operator->() const { return snapshot; }
+    explicit operator bool() const { return snapshot != nullptr; }
+
+private:
+    const MemorySnapshot *snapshot;
+};
+
+std::mutex counterRegistryMutex; // Solo para publicar registros nuevos
+
+// Valores de los contadores de un proceso leídos de una vez
+struct ProcessFrameCounts
+{
+    int ram_frames = 0;
+    int swap_frames = 0;
+    int pinned_frames = 0;
+};
+
+// Lee los contadores de un process_id (todo a cero si no tiene frames) sin locks ni
+// esperas. Con la imagen compartida son los del proceso en la región.
+ProcessFrameCounts readProcessCounters(int process_id)
+{
+    const ProcessFrameCounters *counters = sharedImage.attached() ? sharedImage.processCounters(process_id) : nullptr;
+    SnapshotReader snapshot;
+    if (counters == nullptr && snapshot)
+    {
+        auto process = snapshot->processes.find(process_id);
+        counters = process == snapshot->processes.end() ? nullptr : process->second.get();
+    }
+    if (counters == nullptr)
+    {
+        return {};
+    }
+    return {counters->ram_frames.load(), counters->swap_frames.load(), counters->pinned_frames.load()};
+}
+
+// Contadores de un process_id para actualizarlos. La primera vez se crean y se publica un
+// registro nuevo que los incluye; después es una búsqueda sin locks. Con la imagen
+// compartida, un proceso que no está en la región usa el registro local.
+// El llamador tiene imageMutex: los contadores solo se retiran en modo exclusivo.
+ProcessFrameCounters &processCounters(int process_id)
+{
+    if (sharedImage.attached())
+    {
+        if (ProcessFrameCounters *counters = sharedImage.processCounters(process_id))
+        {
+            return *counters;
+        }
+    }
+    {
+        SnapshotReader snapshot;
+        if (snapshot)
+        {
+            auto counters = snapshot->processes.find(process_id);
+            if (counters != snapshot->processes.end())
+            {
+                return *counters->second;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> registryLock(counterRegistryMutex);
+    SnapshotReader snapshot;
+    auto registry = std::make_unique<MemorySnapshot>();
+    if (snapshot)
+    {
+        auto counters = snapshot->processes.find(process_id);
+        if (counters != snapshot->processes.end())
+        {
+            return *counters->second;
+        }
+        registry->version = snapshot->version;
+        registry->processes = snapshot->processes;
+    }
+    registry->version++;
+    auto counters = std::make_shared<ProcessFrameCounters>();
+    registry->processes[process_id] = counters;
+    memorySnapshots.publish(std::move(registry));
+    return *counters;
+}
+
+// Quita del registro un process_id que ya no tiene frames (un frame compartido puede
+// seguir a su nombre). El llamador tiene imageMutex en modo exclusivo.
+void retireProcessCountersLocked(int process_id)
+{
+    std::lock_guard<std::mutex> registryLock(counterRegistryMutex);
+    SnapshotReader snapshot;
+    if (!snapshot)
+    {
+        return;
+    }
+    auto process = snapshot->processes.find(process_id);
+    if (process == snapshot->processes.end() || process->second->ram_frames != 0 || process->second->swap_frames != 0 ||
+        process->second->pinned_frames != 0)
+    {
+        return;
+    }
+    auto registry = std::make_unique<MemorySnapshot>();
+    registry->version = snapshot->version + 1;
+    registry->processes = snapshot->processes;
+    registry->processes.erase(process_id);
+    memorySnapshots.publish(std::move(registry));
+}
+
+// Cambia el contador de fijación copiado en el frame de RAM y lleva la cuenta de los
+// frames fijados. El llamador es el dueño del frame.
+void setRamFramePinCount(int frame_number, int pin_count)
+{
+    Frame &frame = ramFrames[frame_number];
+    if ((frame.pin_count > 0) != (pin_count > 0))
+    {
+        int frames = pin_count > 0 ? std::max(frame.span, 1) : -std::max(frame.span, 1);
+        frameCounters().pinned_ram += frames;
+        processCounters(frame.process_id).pinned_frames += frames;
+    }
+    frame.pin_count = pin_count;
+}
+
+// Recalcula todos los contadores con los frames recién cargados.
+// El llamador tiene imageMutex en modo exclusivo.
+void recountFramesLocked()
+{
+    frameCounters().free_ram = 0;
+    frameCounters().free_swap = 0;
+    frameCounters().pinned_ram = 0;
+
+    // Registro nuevo con solo los process_id que tienen frames en la imagen; con la imagen
+    // compartida, los procesos dados de alta en la región cuentan en la suya
+    auto registry = std::make_unique<MemorySnapshot>();
+    auto countersOf = [&registry](int process_id) -> ProcessFrameCounters &
+    {
+        if (ProcessFrameCounters *counters = sharedImage.attached() ? sharedImage.processCounters(process_id) : nullptr)
+        {
+            return *counters;
+        }
+        auto &counters = registry->processes[process_id];
+        if (!counters)
+        {
+            counters = std::make_shared<ProcessFrameCounters>();
+        }
+        return *counters;
+    };
+
+    for (const auto &frame : ramFrames)
+    {
+        if (frame.is_free)
+        {
+            frameCounters().free_ram++;
+            continue;
+        }
+        ProcessFrameCounters &counters = countersOf(frame.process_id);
+        counters.ram_frames++;
+        if (frame.pin_count > 0)
+        {
+            frameCounters().pinned_ram += std::max(frame.span, 1);
+            counters.pinned_frames += std::max(frame.span, 1);
+        }
+    }
+    for (const auto &frame : swapFrames)
+    {
+        if (frame.is_free)
+        {
+            frameCounters().free_swap++;
+        }
+        else
+        {
+            countersOf(frame.process_id).swap_frames++;
+        }
+    }
+
+    std::lock_guard<std::mutex> registryLock(counterRegistryMutex);
+    SnapshotReader snapshot;
+    registry->version = snapshot ? snapshot->version + 1 : 1;
+    memorySnapshots.publish(std::move(registry));
+}
+
 class MemoryCalculator
 {
 public:
-    MemoryCalculator(const std::vector<Frame> &frames) : frames(frames) {}
+    explicit MemoryCalculator(const FrameCounters &counters) : counters(counters) {}
+
+    // Método para calcular la memoria disponible
+    int calculateAvailableMemory()
+    {
+        return counters.free_ram.load() * frameSize();
+    }
+
+    // Método para calcular la memoria consumida por un proceso específico
+    int calculateMemoryUsedByProcess(int process_id)
+    {
+        return readProcessCounters(process_id).ram_frames * frameSize();
+    }
+
+    // Método para calcular la memoria fijada (no desalojable) de todo el sistema
+    int calculatePinnedMemory()
+    {
+        return counters.pinned_ram.load() * frameSize();
+    }
+
+private:
+    // Un frame guarda una página base de pageSize bytes; las páginas grandes ocupan varios
+    static int frameSize()
+    {
+        return pageSize;
+    }
+
+    const FrameCounters &counters;
+};
+
+// Página que usa un frame
+struct FrameUser
+{
+    int process_id;
+    int segment_id;
+    int page_number;
+
+    bool operator==(const FrameUser &other) const
+    {
+        return process_id == other.process_id && segment_id == other.segment_id && page_number == other.page_number;
+    }
+};
+
+// Índice de contenido de una tabla de frames para la deduplicación (como KSM en Linux).
+// Cada contenido indexado tiene un solo frame canónico; las páginas que lo comparten le
+// suman referencias extra. Un frame indexado no se modifica hasta sacarlo del índice, y
+// un frame con referencias extra solo lo leen sus páginas (al escribir se copia).
+// El frame lleva los datos de su dueño (la primera página); el índice guarda las demás
+// para pasarle el frame a una de ellas cuando el dueño lo suelta.
+// Quien lo usa tiene dedupMutex.
+class FrameContentIndex
+{
+public:
+    explicit FrameContentIndex(std::string (*contentOf)(int)) : contentOf(contentOf) {}
+
+    // Frame indexado con ese contenido, o -1
+    int find(std::string_view content) const
+    {
+        auto bucket = byHash.find(hashContent(content));
+        if (bucket != byHash.end())
+        {
+            for (int frame_number : bucket->second)
+            {
+                if (contentOf(frame_number) == content)
+                {
+                    return frame_number;
+                }
+            }
+        }
+        return -1;
+    }
+
+    bool indexed(int frame_number) const
+    {
+        return hashOf.count(frame_number) > 0;
+    }
+
+    // Indexa el frame salvo que ya haya otro con el mismo contenido
+    bool insert(int frame_number)
+    {
+        std::string content = contentOf(frame_number);
+        if (indexed(frame_number) || find(content) != -1)
+        {
+            return false;
+        }
+        uint64_t hash = hashContent(content);
+        byHash[hash].push_back(frame_number);
+        hashOf[frame_number] = hash;
+        return true;
+    }
+
+    void erase(int frame_number)
+    {
+        auto entry = hashOf.find(frame_number);
+        if (entry == hashOf.end())
+        {
+            return;
+        }
+        auto bucket = byHash.find(entry->second);
+        bucket->second.erase(std::find(bucket->second.begin(), bucket->second.end(), frame_number));
+        if (bucket->second.empty())
+        {
+            byHash.erase(bucket);
+        }
+        hashOf.erase(entry);
+    }
+
+    // Páginas que usan el frame además de su dueño
+    int sharers(int frame_number) const
+    {
+        auto entry = extraReferences.find(frame_number);
+        return entry == extraReferences.end() ? 0 : static_cast<int>(entry->second.size());
+    }
+
+    void addSharer(int frame_number, const FrameUser &user)
+    {
+        extraReferences[frame_number].push_back(user);
+        references++;
+    }
+
+    // Quita la referencia de la página user. Devuelve true si era la última: el frame sale
+    // del índice y quien llama lo limpia y lo devuelve al pool. Si user es el dueño
+    // (owner), el frame pasa a otra de sus páginas y owner cambia.
+    bool dropReference(int frame_number, const FrameUser &user, FrameUser &owner)
+    {
+        auto entry = extraReferences.find(frame_number);
+        if (entry == extraReferences.end())
+        {
+            erase(frame_number);
+            return true;
+        }
+
+        std::vector<FrameUser> &users = entry->second;
+        auto sharer = std::find(users.begin(), users.end(), user);
+        if (sharer == users.end())
+        {
+            owner = users.back(); // Suelta el dueño: hereda el frame la última que lo compartió
+            sharer = users.end() - 1;
+        }
+        users.erase(sharer);
+        if (users.empty())
+        {
+            extraReferences.erase(entry);
+        }
+        references--;
+        return false;
+    }
+
+    // Vacía el índice de contenido; las referencias compartidas se conservan
+    void clearContent()
+    {
+        byHash.clear();
+        hashOf.clear();
+    }
+
+    void clear()
+    {
+        clearContent();
+        extraReferences.clear();
+        references = 0;
+    }
+
+    // Referencias extra de todos los frames: páginas que no ocupan un frame propio
+    long long sharedReferences() const
+    {
+        return references.load(std::memory_order_relaxed);
+    }
+
+    size_t sharedFrames() const
+    {
+        return extraReferences.size();
+    }
+
+    // Bytes que ocuparían las copias que se ahorran
+    size_t bytesSaved() const
+    {
+        size_t bytes = 0;
+        for (const auto &entry : extraReferences)
+        {
+            bytes += contentOf(entry.first).size() * entry.second.size();
+        }
+        return bytes;
+    }
+
+private:
+    static uint64_t hashContent(std::string_view content)
+    {
+        return std::hash<std::string_view>{}(content);
+    }
+
+    std::string (*contentOf)(int);
+    std::unordered_map<uint64_t, std::vector<int>> byHash;
+    std::unordered_map<int, uint64_t> hashOf;
+    std::unordered_map<int, std::vector<FrameUser>> extraReferences;
+    std::atomic<long long> references{0}; // Se lee sin dedupMutex para saber si hay frames compartidos
+};
+
+// Estado de la deduplicación de páginas. dedupMutex va después de los locks de los
+// procesos y no se tiene nunca al pedir otro lock de la imagen.
+std::mutex dedupMutex;
+FrameContentIndex ramContentIndex{[](int frame_number)
+                                   { return ramFrames[frame_number].content; }};
+FrameContentIndex swapContentIndex{swapPageContent};
+
+// Si está activa, las páginas con el mismo contenido comparten frame al cargarse, los
+// fallos reutilizan un frame de RAM idéntico ya residente y el escáner fusiona los duplicados
+std::atomic<bool> pageDeduplication{false};
+
+// Páginas que revisa el escáner en cada pasada y espera entre pasadas
+std::atomic<size_t> dedupPagesPerScan{4096};
+std::atomic<int> dedupScanIntervalMs{200};
+
+struct DedupStats
+{
+    std::atomic<long long> load_merges{0};  // Páginas que al cargarse reutilizaron un frame idéntico
+    std::atomic<long long> fault_merges{0}; // Fallos resueltos con un frame de RAM idéntico ya residente
+    std::atomic<long long> scan_merges{0};  // Frames duplicados que fusionó el escáner
+    std::atomic<long long> cow_copies{0};   // Copias al escribir o fijar una página compartida
+    std::atomic<long long> scans{0};
+    std::atomic<long long> forks{0};             // Procesos creados con forkProcess
+    std::atomic<long long> fork_shared_pages{0}; // Páginas que los hijos comparten con su padre
+};
+
+DedupStats dedupStats;
+
+// Indica si hay que pasar por el índice al soltar frames: la deduplicación está activa o
+// quedan frames compartidos de cuando lo estuvo
+bool deduplicationActive()
+{
+    return pageDeduplication.load(std::memory_order_relaxed) ||
+           ramContentIndex.sharedReferences() > 0 || swapContentIndex.sharedReferences() > 0;
+}
+
+// Pasa un frame compartido (todos los de una página grande) a otra de las páginas que lo
+// usan y le mueve sus contadores. Quien llama tiene dedupMutex.
+void setFrameOwner(std::vector<Frame> &frames, int frame_number, const FrameUser &owner)
+{
+    Frame &first = frames[frame_number];
+    if (first.process_id != owner.process_id)
+    {
+        int span = std::max(first.span, 1);
+        bool ram = &frames == &ramFrames;
+        ProcessFrameCounters &previous = processCounters(first.process_id);
+        ProcessFrameCounters &next = processCounters(owner.process_id);
+        (ram ? previous.ram_frames : previous.swap_frames) -= span;
+        (ram ? next.ram_frames : next.swap_frames) += span;
+        if (ram && first.pin_count > 0)
+        {
+            previous.pinned_frames -= span;
+            next.pinned_frames += span;
+        }
+    }
+    for (int i = 0; i < std::max(first.span, 1); ++i)
+    {
+        frames[frame_number + i].process_id = owner.process_id;
+    }
+    first.segment_id = owner.segment_id;
+    first.page_number = owner.page_number;
+}
+
+// Reconstruye las referencias compartidas a partir de las tablas recién cargadas: cada
+// página guarda su frame, así que dos páginas con el mismo frame lo comparten. El índice
+// de contenido empieza vacío y lo vuelven a llenar las cargas y el escáner.
+// El llamador tiene imageMutex en modo exclusivo.
+void rebuildDeduplicationLocked()
+{
+    std::lock_guard<std::mutex> dedupLock(dedupMutex);
+    ramContentIndex.clear();
+    swapContentIndex.clear();
+
+    std::map<int, std::vector<FrameUser>> ramUsers;
+    std::map<int, std::vector<FrameUser>> swapUsers;
+    for (const auto &process : pageTables)
+    {
+        for (const auto &segmentTable : process.second->segments)
+        {
+            for (const auto &entry : segmentTable.pages)
+            {
+                FrameUser user{process.first, segmentTable.segment_id, entry.page_number};
+                if (entry.presence_bit)
+                {
+                    ramUsers[entry.frame_ram].push_back(user);
+                }
+                if (entry.frame_swap >= 0)
+                {
+                    swapUsers[entry.frame_swap].push_back(user);
+                }
+            }
+        }
+    }
+
+    // Las páginas que no son el dueño del frame lo comparten; si el dueño ya no lo usa,
+    // el frame pasa a la primera
+    auto addSharers = [](FrameContentIndex &index, std::vector<Frame> &frames, std::map<int, std::vector<FrameUser>> &users)
+    {
+        for (auto &frame : users)
+        {
+            if (frame.second.size() < 2)
+            {
+                continue;
+            }
+            const Frame &metadata = frames[frame.first];
+            FrameUser owner{metadata.process_id, metadata.segment_id, metadata.page_number};
+            auto ownerUse = std::find(frame.second.begin(), frame.second.end(), owner);
+            if (ownerUse == frame.second.end())
+            {
+                setFrameOwner(frames, frame.first, frame.second.front());
+                ownerUse = frame.second.begin();
+            }
+            frame.second.erase(ownerUse);
+            for (const auto &user : frame.second)
+            {
+                index.addSharer(frame.first, user);
+            }
+        }
+    };
+    addSharers(ramContentIndex, ramFrames, ramUsers);
+    addSharers(swapContentIndex, swapFrames, swapUsers);
+}
+
+// Busca la tabla de un proceso. El llamador tiene imageMutex.
+ProcessTable *findProcess(int process_id)
+{
+    auto process = pageTables.find(process_id);
+    return process == pageTables.end() ? nullptr : process->second.get();
+}
+
+// Reparte los frames libres en los shards de ramPool y swapPool: los de la imagen local o,
+// con la imagen compartida, los bitmaps de la región. El llamador tiene imageMutex en modo exclusivo.
+void resetFramePoolsLocked()
+{
+    if (sharedImage.attached())
+    {
+        ramPool.attach(sharedImage.ramBitmap(), sharedImage.ramCount(), frameShards);
+        swapPool.attach(sharedImage.swapBitmap(), sharedImage.swapCount(), frameShards);
+        return;
+    }
+    ramPool.reset(ramFrames, frameShards);
+    swapPool.reset(swapFrames, frameShards);
+}
+
+// Acumula las estadísticas de la TLB de una tabla que se descarta
+void retireTLBStats(ProcessTable &table)
+{
+    table.tlb.invalidateProcess(table.process_id);
+    retiredTLBStats.hits += table.tlb.hits();
+    retiredTLBStats.misses += table.tlb.misses();
+    retiredTLBStats.invalidations += table.tlb.invalidations();
+}
+
+// Pone las tablas locales al día con la lista de procesos de la imagen compartida: crea
+// vacías las de los procesos nuevos (se llenan al usarlas) y descarta las de los que ya
+// no están o se volvieron a crear. Sus frames no se tocan: son de la región.
+// El llamador tiene imageMutex en modo exclusivo.
+void refreshSharedDirectoryLocked()
+{
+    uint64_t version = sharedImage.directoryVersion();
+    std::unordered_map<int, uint64_t> processes;
+    sharedImage.forEachProcess([&](int process_id, uint64_t incarnation)
+                               { processes[process_id] = incarnation; });
+
+    for (auto process = pageTables.begin(); process != pageTables.end();)
+    {
+        auto shared = processes.find(process->first);
+        if (shared == processes.end() || shared->second != process->second->shared_incarnation)
+        {
+            retireTLBStats(*process->second);
+            process = pageTables.erase(process);
+        }
+        else
+        {
+            ++process;
+        }
+    }
+    for (const auto &shared : processes)
+    {
+        if (pageTables.count(shared.first) == 0)
+        {
+            auto table = std::make_shared<ProcessTable>();
+            table->process_id = shared.first;
+            table->shared_incarnation = shared.second;
+            pageTables[shared.first] = table;
+        }
+    }
+    sharedImage.seenDirectory = version;
+}
+
+// Carga (o recarga) la imagen en memoria desde RAM.json y Swap.json. Con la imagen
+// compartida solo prepara la copia local: metadatos de frames vacíos y las tablas de los
+// procesos de la región, que se llenan al usarlas. El llamador tiene imageMutex en modo exclusivo.
+bool loadMemoryImageLocked()
+{
+    if (sharedImage.attached())
+    {
+        Frame freeFrame{"", 0, true, 0, 0, 0, 0, 1};
+        ramFrames.assign(sharedImage.ramCount(), freeFrame);
+        swapFrames.assign(sharedImage.swapCount(), freeFrame);
+        for (size_t i = 0; i < ramFrames.size(); ++i)
+        {
+            ramFrames[i].frame_number = static_cast<int>(i);
+        }
+        for (size_t i = 0; i < swapFrames.size(); ++i)
+        {
+            swapFrames[i].frame_number = static_cast<int>(i);
+        }
+        pageTables.clear();
+        resetFramePoolsLocked();
+        compressedPageCache.clear();
+        compressedSwapStore.reset(0);
+        ramImageModified = false;
+        swapImageModified = false;
+        refreshSharedDirectoryLocked();
+        imageLoaded = true;
+        return true;
+    }
+
+    std::ifstream ramJsonFile(jsonRAMPath);
+    if (!ramJsonFile.is_open())
+    {
+        std::cerr << "No se pudo abrir el archivo principal JSON: " << jsonRAMPath << std::endl;
+        return false;
+    }
+    json jsonRAM;
+    ramJsonFile >> jsonRAM;
+    ramJsonFile.close();
+
+    std::ifstream swapJsonFile(jsonSwapPath);
+    if (!swapJsonFile.is_open())
+    {
+        std::cerr << "No se pudo abrir el archivo secundario JSON: " << jsonSwapPath << std::endl;
+        return false;
+    }
+    json jsonSwap;
+    swapJsonFile >> jsonSwap;
+    swapJsonFile.close();
+
+    ramFrames = framesFromJson(jsonRAM);
+    swapFrames = framesFromJson(jsonSwap);
+    resetFramePoolsLocked();
+    pageTables.clear();
+
+    if (jsonRAM.contains("SO"))
+    {
+        for (const auto &process : jsonRAM["SO"])
+        {
+            auto table = std::make_shared<ProcessTable>();
+            table->process_id = process["process_id"];
+            for (const auto &segmento : process["segments"])
+            {
+                SegmentTable segmentTable;
+                segmentTable.segment_id = segmento["segment_id"];
+                segmentTable.page_size = segmento.value("page_size", static_cast<size_t>(pageSize));
+                size_t offset = 0;
+                for (const auto &pagina : segmento["pages"])
+                {
+                    PageTableEntry entry;
+                    entry.page_number = pagina["page_number"];
+                    entry.frame_ram = pagina["frame_ram"];
+                    entry.frame_swap = pagina["frame_swap"];
+                    entry.presence_bit = pagina["presence_bit"] == 1;
+                    entry.dirty_bit = pagina.value("dirty_bit", 0) == 1;
+                    entry.pin_count = pagina.value("pin_count", 0);
+                    entry.offset = offset;
+                    // Las tablas antiguas no guardan "size": se asume el tamaño de página por defecto
+                    entry.size = pagina.value("size", pageSize);
+                    offset += entry.size;
+                    segmentTable.pages.push_back(entry);
+                }
+                rebuildEvictable(segmentTable);
+                table->segments.push_back(segmentTable);
+            }
+            pageTables[table->process_id] = table;
+        }
+    }
+
+    compressedPageCache.clear();
+    packSwapFramesLocked();
+    rebuildDeduplicationLocked();
+    ramImageModified = false;
+    swapImageModified = false;
+    recountFramesLocked();
+    imageLoaded = true;
+    return true;
+}
+
+// Carga la imagen desde los JSON la primera vez que se necesita
+bool ensureMemoryImage()
+{
+    if (imageLoaded.load(std::memory_order_acquire))
+    {
+        return true;
+    }
+
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    return imageLoaded || loadMemoryImageLocked();
+}
+
+// Descarta la imagen en memoria y la vuelve a leer de los JSON
+bool loadMemoryImage()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    return loadMemoryImageLocked();
+}
+
+// Contenido de RAM.json: frames de RAM y tablas de páginas. El llamador tiene imageMutex.
+json ramImageToJson()
+{
+    json jsonRAM;
+    jsonRAM["frames"] = framesToJson(ramFrames, true);
+    jsonRAM["SO"] = json::array();
+
+    std::vector<int> process_ids;
+    for (const auto &process : pageTables)
+    {
+        process_ids.push_back(process.first);
+    }
+    std::sort(process_ids.begin(), process_ids.end());
+
+    for (int process_id : process_ids)
+    {
+        const auto &table = *pageTables[process_id];
+        json processEntry;
+        processEntry["process_id"] = process_id;
+        processEntry["segments"] = json::array();
+        for (const auto &segmentTable : table.segments)
+        {
+            json segmentEntry;
+            segmentEntry["segment_id"] = segmentTable.segment_id;
+            segmentEntry["page_size"] = segmentTable.page_size;
+            segmentEntry["pages"] = json::array();
+            for (const auto &entry : segmentTable.pages)
+            {
+                json pageEntry;
+                pageEntry["page_number"] = entry.page_number;
+                pageEntry["frame_swap"] = entry.frame_swap;
+                pageEntry["frame_ram"] = entry.frame_ram;
+                pageEntry["presence_bit"] = entry.presence_bit ? 1 : 0;
+                pageEntry["dirty_bit"] = entry.dirty_bit ? 1 : 0;
+                pageEntry["pin_count"] = entry.pin_count;
+                pageEntry["size"] = entry.size;
+                segmentEntry["pages"].push_back(pageEntry);
+            }
+            processEntry["segments"].push_back(segmentEntry);
+        }
+        jsonRAM["SO"].push_back(processEntry);
+    }
+    return jsonRAM;
+}
+
+// Guarda en RAM.json y Swap.json las partes de la imagen que cambiaron. Toma imageMutex
+// en modo exclusivo solo mientras copia la imagen a JSON, así lo que se escribe es un
+// estado consistente y las operaciones no esperan a la escritura. Con la imagen
+// compartida no hace nada: cada cambio ya está en la región.
+void persistMemoryImage()
+{
+    if (sharedImage.attached())
+    {
+        return;
+    }
+
+    // persistMutex ordena los puntos de control entre sí: sin él, uno más viejo podría
+    // terminar de escribir después de uno más nuevo
+    std::lock_guard<std::mutex> persistLock(persistMutex);
+    json jsonRAM;
+    json jsonSwap;
+    bool ramChanged;
+    bool swapChanged;
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        if (!imageLoaded)
+        {
+            return;
+        }
+
+        ramChanged = ramImageModified.exchange(false);
+        swapChanged = swapImageModified.exchange(false);
+        if (ramChanged)
+        {
+            jsonRAM = ramImageToJson();
+        }
+        if (swapChanged)
+        {
+            jsonSwap["frames"] = framesToJson(swapFrames, false, swapPageContent);
+        }
+    }
+
+    // Serializar y escribir los archivos ya no necesita la imagen: las operaciones siguen
+    if (ramChanged)
+    {
+        std::ofstream archivoPrincipalJsonSalida(jsonRAMPath);
+        if (archivoPrincipalJsonSalida.is_open())
+        {
+            archivoPrincipalJsonSalida << jsonRAM.dump(4); // Escribir el JSON principal formateado con 4 espacios
+            archivoPrincipalJsonSalida.close();
+        }
+        else
+        {
+            std::cerr << "No se pudo guardar el archivo principal JSON: " << jsonRAMPath << std::endl;
+        }
+    }
+
+    if (swapChanged)
+    {
+        std::ofstream archivoSecundarioJsonSalida(jsonSwapPath);
+        if (archivoSecundarioJsonSalida.is_open())
+        {
+            archivoSecundarioJsonSalida << jsonSwap.dump(4); // Escribir el JSON secundario formateado con 4 espacios
+            archivoSecundarioJsonSalida.close();
+        }
+        else
+        {
+            std::cerr << "No se pudo guardar el archivo secundario JSON: " << jsonSwapPath << std::endl;
+        }
+    }
+}
+
+// Guarda los JSON si la persistencia es inmediata
+void persistIfWriteThrough()
+{
+    if (writeThroughPersistence)
+    {
+        persistMemoryImage();
+    }
+}
+
+// Recarga de la región la tabla de un proceso si otro participante la cambió. El llamador
+// tiene el lock del proceso en la región, imageMutex y el lock de la tabla.
+void syncSharedProcessLocked(ProcessTable &table, int slot)
+{
+    if (table.shared_version != sharedImage.slotVersion(slot))
+    {
+        sharedImage.loadProcess(table, slot);
+    }
+}
+
+// Operación sobre la imagen compartida. Toma en la región los locks de los procesos que
+// va a usar (por process_id ascendente y antes que imageMutex) y pone al día sus tablas
+// locales y, si cambió, la lista de procesos. Con create da de alta los que no existen;
+// los que al terminar no quedaron publicados (la carga falló o se liberaron) se dan de baja.
+// Sin imagen compartida no hace nada.
+//
+// Si un participante muere a mitad de una operación, el siguiente que toma el lock del
+// proceso recarga sus páginas tal como quedaron en la región; los frames que había
+// reservado y aún no estaban en ninguna página quedan perdidos.
+class SharedImageTransaction
+{
+public:
+    explicit SharedImageTransaction(std::vector<int> process_ids = {}, bool create = false)
+    {
+        if (!sharedImage.attached())
+        {
+            return;
+        }
+
+        std::sort(process_ids.begin(), process_ids.end());
+        process_ids.erase(std::unique(process_ids.begin(), process_ids.end()), process_ids.end());
+        for (int process_id : process_ids)
+        {
+            // Si otro participante da de baja el proceso mientras se espera su lock, se
+            // vuelve a dar de alta (con create) o se sigue sin él
+            while (true)
+            {
+                int slot = sharedImage.findSlot(process_id);
+                if (slot == -1 && create)
+                {
+                    slot = sharedImage.createSlot(process_id);
+                }
+                if (slot == -1)
+                {
+                    break;
+                }
+                if (sharedImage.lockSlot(slot, process_id, false))
+                {
+                    held.push_back({process_id, slot});
+                    break;
+                }
+                if (!create)
+                {
+                    break;
+                }
+            }
+        }
+
+        if (sharedImage.directoryVersion() != sharedImage.seenDirectory)
+        {
+            std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+            refreshSharedDirectoryLocked();
+        }
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        for (const auto &process : held)
+        {
+            ProcessTable *table = findProcess(process.process_id);
+            if (table != nullptr)
+            {
+                std::lock_guard<std::mutex> processLock(table->lock);
+                syncSharedProcessLocked(*table, process.slot);
+            }
+        }
+    }
+
+    ~SharedImageTransaction()
+    {
+        for (auto process = held.rbegin(); process != held.rend(); ++process)
+        {
+            if (!sharedImage.slotPublished(process->slot))
+            {
+                sharedImage.releaseSlot(process->slot);
+            }
+            sharedImage.unlockSlot(process->slot);
+        }
+    }
+
+    SharedImageTransaction(const SharedImageTransaction &) = delete;
+    SharedImageTransaction &operator=(const SharedImageTransaction &) = delete;
+
+private:
+    struct HeldProcess
+    {
+        int process_id;
+        int slot;
+    };
+
+    std::vector<HeldProcess> held;
+};
+
+// Lock en la región de un proceso ajeno a la operación (el reclamo desaloja páginas de
+// cualquiera), tomado sin esperar. Sin imagen compartida siempre se obtiene.
+class SharedProcessTryLock
+{
+public:
+    explicit SharedProcessTryLock(int process_id)
+    {
+        if (!sharedImage.attached())
+        {
+            owned = true;
+            return;
+        }
+        int index = sharedImage.findSlot(process_id);
+        if (index != -1 && sharedImage.lockSlot(index, process_id, true))
+        {
+            slot = index;
+            owned = true;
+        }
+    }
+
+    ~SharedProcessTryLock()
+    {
+        if (slot != -1)
+        {
+            sharedImage.unlockSlot(slot);
+        }
+    }
+
+    SharedProcessTryLock(const SharedProcessTryLock &) = delete;
+    SharedProcessTryLock &operator=(const SharedProcessTryLock &) = delete;
+
+    bool owns() const { return owned; }
+    int index() const { return slot; } // -1 sin imagen compartida
+
+private:
+    int slot = -1;
+    bool owned = false;
+};
+
+// Copia la imagen local a la región recién creada: contenido de los frames, frames libres
+// y las páginas de cada proceso. El llamador tiene imageMutex en modo exclusivo.
+bool fillSharedImageLocked()
+{
+    for (size_t i = 0; i < ramFrames.size(); ++i)
+    {
+        const Frame &frame = ramFrames[i];
+        if (frame.is_free)
+        {
+            sharedImage.ramBitmap()[i / 64].fetch_or(uint64_t(1) << (i % 64));
+        }
+        else if (frame.span > 0)
+        {
+            sharedImage.setRamContent(static_cast<int>(i), frame.content);
+        }
+    }
+    for (size_t i = 0; i < swapFrames.size(); ++i)
+    {
+        const Frame &frame = swapFrames[i];
+        if (frame.is_free)
+        {
+            sharedImage.swapBitmap()[i / 64].fetch_or(uint64_t(1) << (i % 64));
+        }
+        else if (frame.span > 0)
+        {
+            sharedImage.setSwapContent(static_cast<int>(i), swapPageContent(static_cast<int>(i)));
+        }
+    }
+    for (auto &process : pageTables)
+    {
+        if (sharedImage.createSlot(process.first) == -1 || !sharedImage.publishProcess(*process.second))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Pasa a trabajar sobre la imagen compartida name (shm_open). Si no existe se crea con la
+// imagen actual (la de los JSON); si existe, se espera como mucho timeout a que quien la
+// creó termine de llenarla. Desde entonces los frames, los contadores y las páginas de
+// todos los procesos viven en la región: cada operación solo toma en ella los locks de sus
+// procesos y sus cambios se ven en el momento; los JSON ya no se leen ni se escriben.
+// No admite la deduplicación ni el Swap o la caché comprimidos.
+// Se llama antes de usar el gestor desde varios hilos.
+bool attachSharedImage(const std::string &name, size_t processCapacity = 256,
+                       std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+{
+    if (sharedImage.attached())
+    {
+        return true;
+    }
+    if (deduplicationActive())
+    {
+        cerr << "La imagen compartida no admite frames deduplicados" << endl;
+        return false;
+    }
+    if (compressedSwap || compressedPageCache.enabled())
+    {
+        cerr << "La imagen compartida no admite el Swap ni la caché comprimidos" << endl;
+        return false;
+    }
+
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    bool created = false;
+    while (!sharedImage.attached())
+    {
+        // Unirse a una región que ya existe no necesita la imagen local
+        bool missing;
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (sharedImage.open(name, std::max(left, std::chrono::milliseconds(0)), missing))
+        {
+            break;
+        }
+        if (!missing)
+        {
+            return false;
+        }
+
+        // La región no existe: se crea con la geometría de la imagen actual. Cada frame
+        // guarda lo que le toca de su página (una página grande reparte su contenido en span frames).
+        if (!imageLoaded && !loadMemoryImageLocked())
+        {
+            return false;
+        }
+        size_t frameBytes = static_cast<size_t>(pageSize);
+        for (size_t i = 0; i < ramFrames.size(); ++i)
+        {
+            size_t span = static_cast<size_t>(std::max(ramFrames[i].span, 1));
+            frameBytes = std::max(frameBytes, (ramFrames[i].content.size() + span - 1) / span);
+        }
+        for (size_t i = 0; i < swapFrames.size(); ++i)
+        {
+            size_t span = static_cast<size_t>(std::max(swapFrames[i].span, 1));
+            frameBytes = std::max(frameBytes, (swapPageSize(static_cast<int>(i)) + span - 1) / span);
+        }
+
+        bool exists;
+        created = sharedImage.create(name, ramFrames.size(), swapFrames.size(), processCapacity, frameBytes, exists);
+        if (!created && !exists)
+        {
+            return false;
+        }
+        // Si otro participante la creó entre tanto, se vuelve a intentar unirse a ella
+    }
+
+    if (created && !fillSharedImageLocked())
+    {
+        cerr << "No se pudo crear la imagen compartida con la imagen actual: " << name << endl;
+        sharedImage.detach(true);
+        return false;
+    }
+
+    activeFrameCounters = sharedImage.counters();
+    if (created)
+    {
+        recountFramesLocked(); // Con la imagen local, en los contadores de la región
+        sharedImage.ready();
+    }
+    return loadMemoryImageLocked();
+}
+
+// Deja de usar la imagen compartida (con remove, además la borra). La copia local se
+// descarta: la siguiente operación vuelve a cargar la imagen de los JSON.
+void detachSharedImage(bool remove = false)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    if (!sharedImage.attached())
+    {
+        return;
+    }
+    sharedImage.detach(remove);
+    activeFrameCounters = &localFrameCounters;
+    pageTables.clear();
+    ramFrames.clear();
+    swapFrames.clear();
+    resetFramePoolsLocked();
+    imageLoaded = false;
+}
+
+// Reserva un frame libre de RAM para la página indicada; una página grande reserva span
+// frames seguidos y se identifica por el primero. Devuelve -1 si no hay frames libres.
+int allocateRamFrame(int process_id, int segment_id, int page_number, int span = 1)
+{
+    int frame_number = ramPool.allocate(process_id, span);
+    if (frame_number == -1)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < span; ++i)
+    {
+        Frame &frame = ramFrames[frame_number + i];
+        frame.is_free = false;
+        frame.process_id = process_id;
+        frame.segment_id = segment_id;
+        frame.page_number = page_number;
+        frame.pin_count = 0;
+        frame.span = i == 0 ? span : 0;
+    }
+    frameCounters().free_ram -= span;
+    processCounters(process_id).ram_frames += span;
+    ramImageModified = true;
+    return frame_number;
+}
+
+// Devuelve al pool el frame de RAM de una página (todos los suyos si es grande). El
+// contenido ya lo limpió el proceso dueño.
+void releaseRamFrame(int frame_number)
+{
+    int span = std::max(ramFrames[frame_number].span, 1);
+    setRamFramePinCount(frame_number, 0);
+    processCounters(ramFrames[frame_number].process_id).ram_frames -= span;
+    frameCounters().free_ram += span;
+    for (int i = 0; i < span; ++i)
+    {
+        Frame &frame = ramFrames[frame_number + i];
+        frame.is_free = true;  // Actualizar is_free
+        frame.segment_id = 0;  // Reiniciar segment_id
+        frame.page_number = 0; // Reiniciar page_number
+        frame.process_id = 0;
+        frame.pin_count = 0;
+        frame.span = 1;
+    }
+    ramImageModified = true;
+    ramPool.release(frame_number, span);
+}
+
+// Reserva un frame libre de Swap (span frames seguidos para una página grande).
+// Devuelve -1 si no hay frames libres.
+int allocateSwapFrame(int process_id, int segment_id, int page_number, int span = 1)
+{
+    int frame_number = swapPool.allocate(process_id, span);
+    if (frame_number == -1)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < span; ++i)
+    {
+        Frame &frame = swapFrames[frame_number + i];
+        frame.is_free = false; // Marcar como ocupado
+        frame.process_id = process_id;
+        frame.segment_id = segment_id;
+        frame.page_number = page_number;
+        frame.span = i == 0 ? span : 0;
+    }
+    frameCounters().free_swap -= span;
+    processCounters(process_id).swap_frames += span;
+    swapImageModified = true;
+    return frame_number;
+}
+
+void releaseSwapFrame(int frame_number)
+{
+    int span = std::max(swapFrames[frame_number].span, 1);
+    processCounters(swapFrames[frame_number].process_id).swap_frames -= span;
+    frameCounters().free_swap += span;
+    for (int i = 0; i < span; ++i)
+    {
+        Frame &frame = swapFrames[frame_number + i];
+        frame.is_free = true;  // Actualizar is_free
+        frame.segment_id = 0;  // Reiniciar segment_id
+        frame.page_number = 0; // Reiniciar page_number
+        frame.process_id = 0;
+        frame.span = 1;
+    }
+    swapImageModified = true;
+    swapPool.release(frame_number, span);
+}
+
+// Suelta la referencia de una página a un frame compartido. Si el frame era suyo pasa a
+// otra de las páginas que lo usan, con sus contadores. Devuelve true si era la última
+// referencia. El llamador tiene dedupMutex.
+bool dropFrameReference(FrameContentIndex &index, std::vector<Frame> &frames, int frame_number, const FrameUser &user)
+{
+    const Frame &frame = frames[frame_number];
+    FrameUser owner{frame.process_id, frame.segment_id, frame.page_number};
+    if (index.dropReference(frame_number, user, owner))
+    {
+        return true;
+    }
+    setFrameOwner(frames, frame_number, owner);
+    return false;
+}
+
+// Suelta la referencia de una página a su frame de RAM. Si otras páginas lo comparten
+// solo se descuenta; si era la última se limpia y vuelve al pool.
+void dropRamFrame(int frame_number, const FrameUser &user)
+{
+    if (deduplicationActive())
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        if (!dropFrameReference(ramContentIndex, ramFrames, frame_number, user))
+        {
+            return;
+        }
+    }
+    setRamPageContent(frame_number, ""); // Limpiar contenido
+    releaseRamFrame(frame_number);
+}
+
+void dropSwapFrame(int frame_number, const FrameUser &user)
+{
+    if (deduplicationActive())
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        if (!dropFrameReference(swapContentIndex, swapFrames, frame_number, user))
+        {
+            return;
+        }
+    }
+    setSwapPageContent(frame_number, ""); // Limpiar contenido
+    releaseSwapFrame(frame_number);
+}
+
+// Guarda una página en un frame. Con la deduplicación activa y shareable, si ya hay un
+// frame indexado con el mismo contenido se comparte en vez de ocupar otro; el frame nuevo
+// se indexa. Si otro hilo indexó el mismo contenido entre tanto, la copia queda fuera del
+// índice hasta que la fusiona el escáner. Devuelve -1 si no hay frames libres.
+template <typename Allocate, typename Write>
+int storePage(FrameContentIndex &index, const FrameUser &user, std::string_view content, bool shareable, Allocate allocate, Write write)
+{
+    shareable = shareable && pageDeduplication.load(std::memory_order_relaxed);
+    if (shareable)
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        int shared = index.find(content);
+        if (shared != -1)
+        {
+            index.addSharer(shared, user);
+            dedupStats.load_merges++;
+            return shared;
+        }
+    }
+
+    int frame_number = allocate();
+    if (frame_number == -1)
+    {
+        return -1;
+    }
+    write(frame_number);
+    if (shareable)
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        index.insert(frame_number);
+    }
+    return frame_number;
+}
+
+int storeSwapPage(int process_id, int segment_id, int page_number, std::string_view content, int span = 1)
+{
+    return storePage(swapContentIndex, {process_id, segment_id, page_number}, content, true, [&]
+                     { return allocateSwapFrame(process_id, segment_id, page_number, span); },
+                     [&](int frame_number)
+                     { setSwapPageContent(frame_number, content); });
+}
+
+int storeRamPage(int process_id, int segment_id, int page_number, std::string_view content, bool shareable, int span = 1)
+{
+    return storePage(ramContentIndex, {process_id, segment_id, page_number}, content, shareable, [&]
+                     { return allocateRamFrame(process_id, segment_id, page_number, span); },
+                     [&](int frame_number)
+                     { setRamPageContent(frame_number, content); });
+}
+
+// Método para calcular la memoria libre de todo el sistema.
+// Las consultas leen contadores que se mantienen al día y no toman imageMutex.
+int freeMem()
+{
+    if (!ensureMemoryImage())
+    {
+        return 0;
+    }
+    MemoryCalculator memoryCalculator(frameCounters());
+    int available_memory = memoryCalculator.calculateAvailableMemory();
+    return available_memory;
+}
+
+// Método para calcular la memoria fijada de todo el sistema
+int pinnedMem()
+{
+    if (!ensureMemoryImage())
+    {
+        return 0;
+    }
+    MemoryCalculator memoryCalculator(frameCounters());
+    return memoryCalculator.calculatePinnedMemory();
+}
+
+// Método para calcular la memoria de RAM que ocupa un proceso
+int usedMem(int process_id)
+{
+    if (!ensureMemoryImage())
+    {
+        return 0;
+    }
+    MemoryCalculator memoryCalculator(frameCounters());
+    return memoryCalculator.calculateMemoryUsedByProcess(process_id);
+}
+
+// Muestra la tabla de páginas de un proceso. La tabla se copia con el lock del proceso
+// (un fallo de ese proceso solo espera a la copia) y se imprime sin locks.
+void printPageTable(int process_id)
+{
+    if (!ensureMemoryImage())
+    {
+        return;
+    }
+
+    std::vector<SegmentTable> segments;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        if (table == nullptr)
+        {
+            std::cerr << "No existe el proceso: " << process_id << std::endl;
+            return;
+        }
+        std::lock_guard<std::mutex> processLock(table->lock);
+        segments = table->segments;
+    }
+
+    int dirty_pages = 0;
+    for (const auto &segmentTable : segments)
+    {
+        for (const auto &entry : segmentTable.pages)
+        {
+            dirty_pages += entry.presence_bit && entry.dirty_bit ? 1 : 0;
+        }
+    }
+    ProcessFrameCounts counters = readProcessCounters(process_id);
+    cout << "Proceso " << process_id
+         << " | Frames RAM: " << counters.ram_frames
+         << " | Frames Swap: " << counters.swap_frames
+         << " | Fijados: " << counters.pinned_frames
+         << " | Modificadas: " << dirty_pages << endl;
+    for (const auto &segmentTable : segments)
+    {
+        cout << "  Segmento " << segmentTable.segment_id << " | Tamaño de página: " << segmentTable.page_size << endl;
+        for (const auto &entry : segmentTable.pages)
+        {
+            cout << "    Página " << entry.page_number
+                 << " | RAM: " << entry.frame_ram
+                 << " | Swap: " << entry.frame_swap
+                 << " | Presente: " << entry.presence_bit
+                 << " | Modificada: " << entry.dirty_bit
+                 << " | Fijada: " << entry.pin_count << endl;
+        }
+    }
+}
+
+// Busca un segmento por número: el segmento n está en la posición n - 1.
+// El llamador tiene el lock del proceso.
+SegmentTable *findSegment(ProcessTable &table, int segment)
+{
+    if (segment < 1 || segment > static_cast<int>(table.segments.size()) || table.segments[segment - 1].segment_id != segment)
+    {
+        return nullptr;
+    }
+    return &table.segments[segment - 1];
+}
+
+// Busca una página por número. Las páginas se numeran desde 1 en orden, así que la
+// página n suele estar en la posición n - 1. El llamador tiene el lock del proceso.
+PageTableEntry *findPage(ProcessTable &table, int segment, int page)
+{
+    SegmentTable *segmentTable = findSegment(table, segment);
+    if (segmentTable == nullptr)
+    {
+        return nullptr;
+    }
+    auto &pages = segmentTable->pages;
+    if (page >= 1 && page <= static_cast<int>(pages.size()) && pages[page - 1].page_number == page)
+    {
+        return &pages[page - 1];
+    }
+    for (auto &entry : pages)
+    {
+        if (entry.page_number == page)
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+// Traduce una dirección lógica (segmento, desplazamiento) a su entrada en la tabla de páginas.
+// Devuelve nullptr si la dirección no pertenece al proceso.
+PageTableEntry *translate(ProcessTable &table, int segment, size_t offset)
+{
+    auto &segments = table.segments;
+    if (segment < 1 || segment > static_cast<int>(segments.size()) || segments[segment - 1].segment_id != segment)
+    {
+        return nullptr;
+    }
+
+    auto &pages = segments[segment - 1].pages;
+    auto it = std::upper_bound(pages.begin(), pages.end(), offset,
+                               [](size_t value, const PageTableEntry &entry)
+                               { return value < entry.offset; });
+    if (it == pages.begin())
+    {
+        return nullptr;
+    }
+    --it;
+    if (offset >= it->offset + it->size)
+    {
+        return nullptr;
+    }
+    return &*it;
+}
+
+// Tamaño de página del segmento en bytes (pageSize si el segmento no existe)
+size_t segmentPageSize(const ProcessTable &table, int segment)
+{
+    if (segment < 1 || segment > static_cast<int>(table.segments.size()))
+    {
+        return static_cast<size_t>(pageSize);
+    }
+    return table.segments[segment - 1].page_size;
+}
+
+// Frames que ocupa cada página del segmento
+int segmentPageFrames(const ProcessTable &table, int segment)
+{
+    return static_cast<int>(std::max<size_t>(1, segmentPageSize(table, segment) / static_cast<size_t>(pageSize)));
+}
+
+// Hilos que paginan los programas grandes, contando al que llama (se aplica al crear el grupo)
+size_t paginationThreads = std::max(1u, std::thread::hardware_concurrency());
+
+// Grupo de hilos para paginar y cargar programas grandes por trozos. Quien llama a
+// forEachChunk también trabaja en sus trozos, así las llamadas anidadas o simultáneas
+// desde varios hilos siempre avanzan aunque todos los hilos del grupo estén ocupados.
+class ChunkPool
+{
+public:
+    explicit ChunkPool(size_t workers)
+    {
+        for (size_t i = 0; i < workers; ++i)
+        {
+            threads.emplace_back([this]
+                                 { workerLoop(); });
+        }
+    }
+
+    ~ChunkPool()
+    {
+        {
+            std::lock_guard<std::mutex> jobsLock(jobsMutex);
+            stopping = true;
+        }
+        jobsReady.notify_all();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    ChunkPool(const ChunkPool &) = delete;
+    ChunkPool &operator=(const ChunkPool &) = delete;
+
+    // Hilos que pueden trabajar en un trabajo, contando al que llama
+    size_t concurrency() const { return threads.size() + 1; }
+
+    // Ejecuta task(chunk) para cada chunk en [0, chunks) y vuelve cuando terminan todos.
+    // Los trozos se reparten en cualquier orden: cada uno debe escribir solo su parte.
+    void forEachChunk(size_t chunks, const std::function<void(size_t)> &task)
+    {
+        if (chunks <= 1 || threads.empty())
+        {
+            for (size_t chunk = 0; chunk < chunks; ++chunk)
+            {
+                task(chunk);
+            }
+            return;
+        }
+
+        auto job = std::make_shared<Job>();
+        job->task = &task;
+        job->chunks = chunks;
+        {
+            std::lock_guard<std::mutex> jobsLock(jobsMutex);
+            jobs.push_back(job);
+        }
+        jobsReady.notify_all();
+
+        runChunks(*job);
+        std::unique_lock<std::mutex> jobsLock(jobsMutex);
+        jobDone.wait(jobsLock, [&job]
+                     { return job->done.load() == job->chunks; });
+    }
+
+private:
+    struct Job
+    {
+        const std::function<void(size_t)> *task = nullptr;
+        size_t chunks = 0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+
+    void runChunks(Job &job)
+    {
+        for (size_t chunk = job.next++; chunk < job.chunks; chunk = job.next++)
+        {
+            (*job.task)(chunk);
+            if (++job.done == job.chunks)
+            {
+                // Se avisa con el lock tomado: el que espera puede destruir la tarea al despertar
+                std::lock_guard<std::mutex> jobsLock(jobsMutex);
+                jobDone.notify_all();
+            }
+        }
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<Job> job;
+            {
+                std::unique_lock<std::mutex> jobsLock(jobsMutex);
+                if (jobs.empty() && !stopping)
+                {
+                    // Antes de quedarse inactivo el hilo devuelve los frames de sus magazines
+                    jobsLock.unlock();
+                    flushThreadMagazines();
+                    jobsLock.lock();
+                }
+                jobsReady.wait(jobsLock, [this]
+                               { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                {
+                    return;
+                }
+                job = jobs.front();
+                if (job->next.load() >= job->chunks)
+                {
+                    // Ya se repartieron todos sus trozos
+                    jobs.pop_front();
+                    continue;
+                }
+            }
+            runChunks(*job);
+        }
+    }
+
+    std::mutex jobsMutex;
+    std::condition_variable jobsReady;
+    std::condition_variable jobDone;
+    std::deque<std::shared_ptr<Job>> jobs;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+};
+
+// Grupo compartido para la paginación, se crea la primera vez que se usa
+ChunkPool &paginationPool()
+{
+    static ChunkPool pool(std::max<size_t>(paginationThreads, 1) - 1);
+    return pool;
+}
+
+// Los textos a partir de este tamaño se paginan y cargan en paralelo por trozos de
+// paginationChunkBytes (0 = siempre en serie). El resultado es idéntico al serie.
+size_t parallelPaginationBytes = 4 << 20;
+size_t paginationChunkBytes = 1 << 20;
+
+// Indica si conviene repartir un texto de bytes bytes entre los hilos del grupo
+bool paginateInParallel(size_t bytes)
+{
+    return parallelPaginationBytes > 0 && bytes >= parallelPaginationBytes && paginationPool().concurrency() > 1;
+}
+
+// Pagina el texto repartiendo los trozos entre los hilos del grupo. Cada trozo tiene un
+// número entero de páginas, así que sus cortes coinciden con los del reparto en serie.
+template <typename Page>
+vector<Page> paginateChunked(std::string_view text, int size)
+{
+    size_t pageBytes = static_cast<size_t>(size);
+    size_t count = (text.size() + pageBytes - 1) / pageBytes;
+    size_t chunkPages = std::max<size_t>(1, paginationChunkBytes / pageBytes);
+    vector<Page> pages(count);
+    paginationPool().forEachChunk((count + chunkPages - 1) / chunkPages, [&](size_t chunk)
+                                  {
+        size_t last = std::min(count, (chunk + 1) * chunkPages);
+        for (size_t i = chunk * chunkPages; i < last; ++i)
+        {
+            pages[i] = Page(text.substr(i * pageBytes, pageBytes));
+        } });
+    return pages;
+}
+
+// Divide el texto en páginas de un tamaño específico. Devuelve vistas sobre el texto, sin copiarlo
+vector<string_view> paginationView(std::string_view text, int size)
+{
+    if (paginateInParallel(text.size()))
+    {
+        return paginateChunked<string_view>(text, size);
+    }
+
+    vector<string_view> pages;
+    for (size_t i = 0; i < text.size(); i += size)
+    {
+        pages.push_back(text.substr(i, size));
+    }
+    return pages;
+}
+
+// Programa proyectado en memoria con mmap. Las páginas que produce segmentProgram a partir
+// de él son vistas sobre la proyección: sus bytes solo se copian al guardarlos en los frames.
+// El MappedProgram tiene que vivir hasta que se suben las páginas.
+class MappedProgram
+{
+public:
+    MappedProgram() = default;
+    MappedProgram(const MappedProgram &) = delete;
+    MappedProgram &operator=(const MappedProgram &) = delete;
+
+    ~MappedProgram()
+    {
+        if (data != nullptr)
+        {
+            munmap(data, length);
+        }
+    }
+
+    bool open(const string &path)
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd == -1)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0)
+        {
+            void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                ::close(fd);
+                return false;
+            }
+            data = static_cast<char *>(address);
+            madvise(data, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    std::string_view text() const
+    {
+        return {data, length};
+    }
+
+    // Guarda bytes que no están en el archivo (el salto de línea que le falta al final)
+    // y devuelve una vista estable sobre ellos
+    std::string_view keep(std::string bytes)
+    {
+        extra.push_back(std::move(bytes));
+        return extra.back();
+    }
+
+private:
+    char *data = nullptr;
+    size_t length = 0;
+    std::deque<std::string> extra;
+};
+
+// Búsqueda de saltos de línea por bloques de 64 bytes: se comparan con SSE2 o AVX2 y se
+// obtiene una máscara con un bit por cada '\n', que se cuenta con popcount o se recorre
+// bit a bit. Sin SIMD la máscara se arma por palabras de 8 bytes.
+constexpr size_t newlineBlock = 64;
+
+// Máscara de los '\n' de los 64 bytes que empiezan en data
+inline uint64_t newlineMask(const char *data)
+{
+#if defined(__AVX2__)
+    const __m256i newline = _mm256_set1_epi8('\n');
+    uint64_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data)), newline)));
+    uint64_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + 32)), newline)));
+    return low | (high << 32);
+#elif defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    uint64_t mask = 0;
+    for (int part = 0; part < 4; ++part)
+    {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + part * 16));
+        mask |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)))) << (part * 16);
+    }
+    return mask;
+#elif defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // Sin SIMD se comparan 8 bytes a la vez dentro de un uint64_t (SWAR)
+    uint64_t mask = 0;
+    for (int part = 0; part < 8; ++part)
+    {
+        uint64_t word;
+        std::memcpy(&word, data + part * 8, sizeof(word));
+        word ^= 0x0a0a0a0a0a0a0a0aULL; // Los '\n' quedan en cero
+        uint64_t zeros = ~(((word & 0x7f7f7f7f7f7f7f7fULL) + 0x7f7f7f7f7f7f7f7fULL) | word) & 0x8080808080808080ULL;
+        // Junta el bit alto de cada byte en los 8 bits de arriba
+        mask |= (((zeros >> 7) * 0x0102040810204080ULL) >> 56) << (part * 8);
+    }
+    return mask;
+#else
+    uint64_t mask = 0;
+    for (size_t i = 0; i < newlineBlock; ++i)
+    {
+        mask |= static_cast<uint64_t>(data[i] == '\n') << i;
+    }
+    return mask;
+#endif
+}
+
+// Máscara del bloque que empieza en position; el último bloque se completa con ceros
+inline uint64_t newlineMaskAt(std::string_view text, size_t position)
+{
+    if (text.size() - position >= newlineBlock)
+    {
+        return newlineMask(text.data() + position);
+    }
+    char tail[newlineBlock] = {};
+    std::memcpy(tail, text.data() + position, text.size() - position);
+    return newlineMask(tail);
+}
+
+inline int popcount64(uint64_t mask)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(mask);
+#else
+    int bits = 0;
+    for (; mask != 0; mask &= mask - 1)
+    {
+        bits++;
+    }
+    return bits;
+#endif
+}
+
+inline int lowestBit(uint64_t mask)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(mask);
+#else
+    int bit = 0;
+    while ((mask & 1) == 0)
+    {
+        mask >>= 1;
+        bit++;
+    }
+    return bit;
+#endif
+}
+
+// Cuenta los saltos de línea del texto
+size_t countNewlines(std::string_view text)
+{
+    size_t newlines = 0;
+    for (size_t position = 0; position < text.size(); position += newlineBlock)
+    {
+        newlines += popcount64(newlineMaskAt(text, position));
+    }
+    return newlines;
+}
+
+// Avanza lines líneas desde position: devuelve la posición que sigue al lines-ésimo salto
+// de línea, o el final del texto si hay menos
+size_t skipLines(std::string_view text, size_t position, size_t lines)
+{
+    while (lines > 0 && position < text.size())
+    {
+        uint64_t mask = newlineMaskAt(text, position);
+        size_t found = static_cast<size_t>(popcount64(mask));
+        if (found < lines)
+        {
+            lines -= found;
+            position += newlineBlock;
+            continue;
+        }
+        for (size_t skipped = 1; skipped < lines; ++skipped)
+        {
+            mask &= mask - 1; // Quitar los saltos anteriores al buscado
+        }
+        return position + lowestBit(mask) + 1;
+    }
+    return std::min(position, text.size());
+}
+
+// Índice de líneas: posición de inicio de cada línea del texto. Como con getline, la
+// última línea puede no terminar en salto de línea
+vector<size_t> indexLines(std::string_view text)
+{
+    vector<size_t> lineStarts;
+    if (text.empty())
+    {
+        return lineStarts;
+    }
+    lineStarts.reserve(countNewlines(text) + 1);
+    lineStarts.push_back(0);
+    for (size_t position = 0; position < text.size(); position += newlineBlock)
+    {
+        for (uint64_t mask = newlineMaskAt(text, position); mask != 0; mask &= mask - 1)
+        {
+            lineStarts.push_back(position + lowestBit(mask) + 1);
+        }
+    }
+    if (lineStarts.back() == text.size())
+    {
+        lineStarts.pop_back();
+    }
+    return lineStarts;
+}
+
+// Saltos de línea de cada trozo de paginationChunkBytes del texto, contados en paralelo
+vector<size_t> countNewlinesByChunk(std::string_view text)
+{
+    size_t chunkBytes = std::max<size_t>(paginationChunkBytes, newlineBlock);
+    vector<size_t> newlines((text.size() + chunkBytes - 1) / chunkBytes);
+    paginationPool().forEachChunk(newlines.size(), [&](size_t chunk)
+                                  { newlines[chunk] = countNewlines(text.substr(chunk * chunkBytes, chunkBytes)); });
+    return newlines;
+}
+
+// Posición que sigue al salto de línea número newline (desde 1) usando la cuenta por
+// trozos de countNewlinesByChunk: solo se recorre el trozo donde está
+size_t positionAfterNewline(std::string_view text, const vector<size_t> &chunkNewlines, size_t newline)
+{
+    size_t chunkBytes = std::max<size_t>(paginationChunkBytes, newlineBlock);
+    size_t chunk = 0;
+    while (chunk < chunkNewlines.size() && chunkNewlines[chunk] < newline)
+    {
+        newline -= chunkNewlines[chunk++];
+    }
+    return chunk < chunkNewlines.size() ? skipLines(text, chunk * chunkBytes, newline) : text.size();
+}
+
+// Pagina cada línea del texto por separado, sin su salto de línea
+void paginateLines(std::string_view text, vector<string_view> &pages)
+{
+    vector<size_t> lineStarts = indexLines(text);
+    for (size_t line = 0; line < lineStarts.size(); ++line)
+    {
+        size_t end = line + 1 < lineStarts.size() ? lineStarts[line + 1] - 1 : text.size() - (text.back() == '\n' ? 1 : 0);
+        auto pageInProgress = paginationView(text.substr(lineStarts[line], end - lineStarts[line]), pageSize);
+        pages.insert(pages.end(), pageInProgress.begin(), pageInProgress.end());
+    }
+}
+
+// Igual que paginateLines pero por trozos en paralelo. Cada trozo empieza en el inicio de
+// una línea y las páginas de los trozos se juntan en orden, como en el reparto en serie.
+vector<string_view> paginateLinesChunked(std::string_view text)
+{
+    vector<string_view> pages;
+    if (!paginateInParallel(text.size()))
+    {
+        paginateLines(text, pages);
+        return pages;
+    }
+
+    size_t chunkBytes = std::max<size_t>(paginationChunkBytes, 1);
+    size_t chunks = (text.size() + chunkBytes - 1) / chunkBytes;
+    vector<size_t> starts(chunks + 1, text.size());
+    starts[0] = 0;
+    for (size_t chunk = 1; chunk < chunks; ++chunk)
+    {
+        // Primera línea que empieza en el trozo o después
+        starts[chunk] = skipLines(text, chunk * chunkBytes - 1, 1);
+    }
+
+    vector<vector<string_view>> chunkPages(chunks);
+    paginationPool().forEachChunk(chunks, [&](size_t chunk)
+                                  {
+        if (starts[chunk] < starts[chunk + 1])
+        {
+            paginateLines(text.substr(starts[chunk], starts[chunk + 1] - starts[chunk]), chunkPages[chunk]);
+        } });
+    for (auto &part : chunkPages)
+    {
+        pages.insert(pages.end(), part.begin(), part.end());
+    }
+    return pages;
+}
+
+// Libera los frames de RAM y Swap de una tabla de páginas. Quien llama es el dueño de
+// esos frames: tiene imageMutex (compartido basta si la tabla aún no está publicada).
+void releaseTableFrames(ProcessTable &table)
+{
+    for (auto &segmentTable : table.segments)
+    {
+        for (auto &entry : segmentTable.pages)
+        {
+            FrameUser user{table.process_id, segmentTable.segment_id, entry.page_number};
+            if (entry.presence_bit)
+            {
+                dropRamFrame(entry.frame_ram, user);
+            }
+            if (entry.frame_swap >= 0)
+            {
+                dropSwapFrame(entry.frame_swap, user);
+            }
+        }
+    }
+}
+
+// Libera los frames de RAM y Swap de una tabla de páginas y acumula las estadísticas
+// de su TLB. El llamador tiene imageMutex en modo exclusivo.
+void releaseProcessFramesLocked(ProcessTable &table)
+{
+    releaseTableFrames(table);
+    retireTLBStats(table);
+}
+
+// Libera la memoria de un proceso y borra su tabla de direcciones.
+// El llamador tiene imageMutex en modo exclusivo.
+void releaseProcessLocked(int process_id)
+{
+    auto process = pageTables.find(process_id);
+    if (process == pageTables.end())
+    {
+        return;
+    }
+
+    releaseProcessFramesLocked(*process->second);
+    pageTables.erase(process);
+    sharedImage.unpublishProcess(process_id);
+    retireProcessCountersLocked(process_id);
+    ramImageModified = true;
+}
+
+// Función usada para liberar la memoria de un proceso
+void releaseMemory(int process_id)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        return;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        releaseProcessLocked(process_id);
+    }
+
+    persistIfWriteThrough();
+    std::cout << "Memoria liberada en JSON principal y secundario para process_id: " << process_id << std::endl;
+}
+
+// Frames por página para un segmento de ese tamaño en bytes, según la política de páginas grandes
+int hugePageSpan(size_t bytes)
+{
+    if (hugePageFrames <= 1 || bytes < hugePageMinBytes)
+    {
+        return 1;
+    }
+    return hugePageFrames;
+}
+
+// Junta cada span páginas seguidas en una página grande. Si son vistas contiguas del mismo
+// texto la página grande también es una vista; si no, se copia en storage.
+template <typename Page>
+std::vector<std::string_view> groupPages(const std::vector<Page> &pages, size_t span, std::vector<std::string> &storage)
+{
+    std::vector<std::string_view> grouped;
+    grouped.reserve((pages.size() + span - 1) / span);
+    storage.reserve(grouped.capacity()); // Sin reubicaciones: las vistas apuntan a storage
+    for (size_t first = 0; first < pages.size(); first += span)
+    {
+        size_t last = std::min(pages.size(), first + span);
+        std::string_view head = pages[first];
+        size_t bytes = head.size();
+        bool contiguous = true;
+        for (size_t j = first + 1; j < last; ++j)
+        {
+            std::string_view page = pages[j];
+            contiguous = contiguous && page.data() == head.data() + bytes;
+            bytes += page.size();
+        }
+        if (contiguous)
+        {
+            grouped.emplace_back(head.data(), bytes);
+            continue;
+        }
+
+        std::string &copy = storage.emplace_back();
+        copy.reserve(bytes);
+        for (size_t j = first; j < last; ++j)
+        {
+            copy.append(std::string_view(pages[j]));
+        }
+        grouped.emplace_back(copy);
+    }
+    return grouped;
+}
+
+// Añade un segmento a la tabla: guarda todas sus páginas en Swap y la primera en RAM.
+// Si no hay frames, el segmento queda en la tabla con lo que se alcanzó a guardar (para
+// poder liberarlo) y devuelve false. Las páginas pueden ser std::string o std::string_view.
+// El llamador tiene imageMutex; basta en modo compartido si la tabla aún no está publicada.
+// Cada página ocupa span frames (más de uno con páginas grandes).
+template <typename Page>
+bool loadSegmentPages(ProcessTable &table, const std::vector<Page> &pages, int span)
+{
+    int process_id = table.process_id;
+    int segment_id = static_cast<int>(table.segments.size() + 1);
+
+    SegmentTable segmentTable;
+    segmentTable.segment_id = segment_id;
+    segmentTable.page_size = static_cast<size_t>(span) * static_cast<size_t>(pageSize);
+
+    // Guardar todas las paginas en Swap
+    size_t offset = 0;
+    if (paginateInParallel(pages.size() * segmentTable.page_size))
+    {
+        // Las entradas se crean en orden y los trozos solo reservan sus frames de Swap y
+        // copian sus páginas; una entrada sin frame queda con frame_swap = -1
+        segmentTable.pages.reserve(pages.size());
+        for (size_t j = 0; j < pages.size(); ++j)
+        {
+            segmentTable.pages.push_back({static_cast<int>(j + 1), -1, -1, false, false, 0, offset, pages[j].size()});
+            offset += pages[j].size();
+        }
+
+        size_t chunkPages = std::max<size_t>(1, paginationChunkBytes / segmentTable.page_size);
+        std::atomic<bool> swapFull{false};
+        paginationPool().forEachChunk((pages.size() + chunkPages - 1) / chunkPages, [&](size_t chunk)
+                                      {
+            size_t last = std::min(pages.size(), (chunk + 1) * chunkPages);
+            for (size_t j = chunk * chunkPages; j < last && !swapFull; ++j)
+            {
+                PageTableEntry &entry = segmentTable.pages[j];
+                entry.frame_swap = storeSwapPage(process_id, segment_id, entry.page_number, pages[j], span);
+                if (entry.frame_swap == -1)
+                {
+                    swapFull = true;
+                    return;
+                }
+            } });
+        if (swapFull)
+        {
+            std::cerr << "Memoria Swap Insuficiente" << std::endl;
+            table.segments.push_back(segmentTable);
+            return false;
+        }
+    }
+    for (size_t j = segmentTable.pages.size(); j < pages.size(); ++j)
+    {
+        int page_number = static_cast<int>(j + 1);
+        int swapFrame_id = storeSwapPage(process_id, segment_id, page_number, pages[j], span);
+        if (swapFrame_id == -1)
+        {
+            std::cerr << "Memoria Swap Insuficiente" << std::endl;
+            table.segments.push_back(segmentTable);
+            return false;
+        }
+
+        // Añadir la página en la tabla de paginación del segmento
+        segmentTable.pages.push_back({page_number, -1, swapFrame_id, false, false, 0, offset, pages[j].size()});
+        offset += pages[j].size();
+    }
+
+    // Guardar la primera subparte en RAM
+    if (!pages.empty())
+    {
+        // Una página fijada no se comparte
+        int ramFrame_id = storeRamPage(process_id, segment_id, 1, pages[0], !pinFirstPageOfSegment, span);
+        if (ramFrame_id == -1)
+        {
+            std::cerr << "Memoria RAM Insuficiente" << std::endl;
+            table.segments.push_back(segmentTable);
+            return false;
+        }
+
+        PageTableEntry &first = segmentTable.pages[0];
+        first.frame_ram = ramFrame_id;
+        first.presence_bit = true;
+        if (pinFirstPageOfSegment)
+        {
+            first.pin_count = 1;
+            setRamFramePinCount(ramFrame_id, 1);
+        }
+        updateEvictable(segmentTable, first);
+    }
+
+    // Añadir el segmento con sus páginas a la tabla del proceso
+    table.segments.push_back(segmentTable);
+    return true;
+}
+
+// Añade un segmento a la tabla con páginas normales o, si es lo bastante grande, con
+// páginas grandes (ver hugePageFrames)
+template <typename Page>
+bool loadSegment(ProcessTable &table, const std::vector<Page> &pages)
+{
+    size_t bytes = 0;
+    for (const auto &page : pages)
+    {
+        bytes += page.size();
+    }
+
+    int span = hugePageSpan(bytes);
+    if (span == 1)
+    {
+        return loadSegmentPages(table, pages, 1);
+    }
+    std::vector<std::string> storage;
+    return loadSegmentPages(table, groupPages(pages, static_cast<size_t>(span), storage), span);
+}
+
+// Crea la tabla del proceso y reparte sus páginas en Swap y RAM.
+// El llamador tiene imageMutex en modo exclusivo.
+template <typename Page>
+bool uploadToRamLocked(const std::vector<std::vector<Page>> &segments, int process_id)
+{
+    // **Verificar si el proceso ya existe**: liberar la memoria del proceso existente
+    releaseProcessLocked(process_id);
+
+    // Crear la tabla de paginación del proceso
+    auto table = std::make_shared<ProcessTable>();
+    table->process_id = process_id;
+
+    // Iterar sobre los segmentos y paginas para organizarlas en RAM y Swap
+    for (const auto &pages : segments)
+    {
+        if (!loadSegment(*table, pages))
+        {
+            releaseProcessFramesLocked(*table);
+            return false;
+        }
+    }
+
+    // Con la imagen compartida la tabla se publica en la región antes de hacerla visible
+    if (sharedImage.attached() && !sharedImage.publishProcess(*table))
+    {
+        releaseProcessFramesLocked(*table);
+        return false;
+    }
+
+    // Agregar la tabla del proceso a la lista de procesos
+    pageTables[process_id] = table;
+    ramImageModified = true;
+    return true;
+}
+
+template <typename Page>
+bool uploadToRam(const std::vector<std::vector<Page>> &segments, int process_id)
+{
+    SharedImageTransaction transaction({process_id}, true);
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        bool uploaded = uploadToRamLocked(segments, process_id);
+        if (!uploaded)
+        {
+            return false;
+        }
+    }
+
+    if (writeThroughPersistence)
+    {
+        persistMemoryImage();
+        std::cout << "JSON principal y secundario actualizados correctamente." << std::endl;
+    }
+    return true;
+}
+
+// Estrategia para repartir el texto de un programa en segmentos. Cada segmento se pagina
+// después como un solo texto. Los segmentos son vistas sobre el texto y lo cubren entero.
+class Segmenter
+{
+public:
+    virtual ~Segmenter() = default;
+    virtual std::string name() const = 0;
+    virtual vector<string_view> split(std::string_view text) const = 0;
+
+protected:
+    // Parte el texto en grupos de linesPerSegment líneas
+    static vector<string_view> splitLines(std::string_view text, size_t linesPerSegment)
+    {
+        vector<string_view> segments;
+        size_t position = 0;
+        while (position < text.size())
+        {
+            size_t begin = position;
+            position = skipLines(text, position, linesPerSegment);
+            segments.push_back(text.substr(begin, position - begin));
+        }
+        return segments;
+    }
+};
+
+// Segmentos de un número fijo de bytes (el último puede ser menor). Con un múltiplo de
+// pageSize ninguna página queda a medias salvo la última del programa.
+class FixedBytesSegmenter : public Segmenter
+{
+public:
+    explicit FixedBytesSegmenter(size_t bytes) : bytes(std::max<size_t>(bytes, 1)) {}
+
+    std::string name() const override { return "Bytes fijos (" + std::to_string(bytes) + ")"; }
+
+    vector<string_view> split(std::string_view text) const override
+    {
+        vector<string_view> segments;
+        for (size_t i = 0; i < text.size(); i += bytes)
+        {
+            segments.push_back(text.substr(i, bytes));
+        }
+        return segments;
+    }
+
+private:
+    size_t bytes;
+};
+
+// Segmentos de un número fijo de líneas
+class FixedLinesSegmenter : public Segmenter
+{
+public:
+    explicit FixedLinesSegmenter(size_t lines) : lines(std::max<size_t>(lines, 1)) {}
+
+    std::string name() const override { return "Líneas fijas (" + std::to_string(lines) + ")"; }
+
+    vector<string_view> split(std::string_view text) const override
+    {
+        return splitLines(text, lines);
+    }
+
+private:
+    size_t lines;
+};
+
+// N segmentos con el mismo número de líneas (el reparto de siempre, pero la última parte
+// también se pagina como un solo texto)
+class EqualSegmentsSegmenter : public Segmenter
+{
+public:
+    explicit EqualSegmentsSegmenter(size_t parts) : parts(std::max<size_t>(parts, 1)) {}
+
+    std::string name() const override { return std::to_string(parts) + " segmentos iguales"; }
+
+    vector<string_view> split(std::string_view text) const override
+    {
+        size_t lines = countNewlines(text) + (!text.empty() && text.back() != '\n' ? 1 : 0);
+        return splitLines(text, std::max<size_t>(1, (lines + parts - 1) / parts));
+    }
+
+private:
+    size_t parts;
+};
+
+// Segmentador sencillo para C++: corta al cerrar cada bloque de primer nivel (funciones,
+// clases...) y junta bloques seguidos hasta que el segmento llega a minBytes. Lo que hay
+// entre bloques (includes, declaraciones) va con el bloque siguiente. Sigue las llaves
+// saltándose comentarios, cadenas y caracteres; no reconoce raw strings ni macros.
+class FunctionSegmenter : public Segmenter
+{
+public:
+    explicit FunctionSegmenter(size_t minBytes = 0) : minBytes(minBytes) {}
+
+    std::string name() const override { return "Funciones de C++ (mín. " + std::to_string(minBytes) + " bytes)"; }
+
+    vector<string_view> split(std::string_view text) const override
+    {
+        vector<string_view> segments;
+        size_t begin = 0;
+        int depth = 0;
+        bool closedBlock = false; // Se cerró un bloque de primer nivel en esta línea
+        for (size_t i = 0; i < text.size(); ++i)
+        {
+            char c = text[i];
+            char next = i + 1 < text.size() ? text[i + 1] : '\0';
+            if (c == '/' && next == '/')
+            {
+                i = text.find('\n', i);
+                if (i == std::string_view::npos)
+                {
+                    break;
+                }
+                c = '\n';
+            }
+            else if (c == '/' && next == '*')
+            {
+                size_t end = text.find("*/", i + 2);
+                i = end == std::string_view::npos ? text.size() - 1 : end + 1;
+                continue;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                for (++i; i < text.size() && text[i] != c && text[i] != '\n'; ++i)
+                {
+                    if (text[i] == '\\')
+                    {
+                        ++i;
+                    }
+                }
+                if (i < text.size() && text[i] == '\n')
+                {
+                    --i; // Literal sin cerrar: el salto de línea se trata en la vuelta siguiente
+                }
+                continue;
+            }
+            else if (c == '{')
+            {
+                depth++;
+            }
+            else if (c == '}' && depth > 0)
+            {
+                depth--;
+                closedBlock = closedBlock || depth == 0;
+            }
+
+            // El segmento termina al final de la línea en la que se cerró el bloque
+            if (c == '\n' && closedBlock)
+            {
+                closedBlock = false;
+                if (i + 1 - begin >= minBytes)
+                {
+                    segments.push_back(text.substr(begin, i + 1 - begin));
+                    begin = i + 1;
+                }
+            }
+        }
+        if (begin < text.size())
+        {
+            segments.push_back(text.substr(begin));
+        }
+        return segments;
+    }
+
+private:
+    size_t minBytes;
+};
+
+// Estrategia que usan memoryAllocation y los demás cargadores. Sin estrategia se usa el
+// reparto original en tres partes (la última paginada línea a línea).
+std::shared_ptr<const Segmenter> programSegmenter;
+
+// Resultado de segmentar un programa con una estrategia
+struct SegmentationReport
+{
+    std::string strategy;
+    size_t segments = 0;
+    size_t pages = 0;
+    size_t bytes = 0;
+    size_t fragmentation = 0; // Bytes sin usar en las páginas a medio llenar
+};
+
+// Segmenta el programa en una sola lectura y sin copiarlo: lo proyecta con mmap, cuenta sus
+// líneas en memoria (no vuelve a abrir el archivo) y entrega cada segmento a onSegment en
+// cuanto está completo, así se le pueden asignar frames mientras se pagina el resto.
+// Las páginas son vistas sobre la proyección. Si onSegment devuelve false se deja de segmentar.
+// segmenter elige la estrategia (nullptr = el reparto original en tres partes).
+bool segmentProgramStreaming(const string &programPath, MappedProgram &program, const std::function<bool(vector<string_view> &)> &onSegment,
+                             const Segmenter *segmenter)
+{
+    if (!program.open(programPath))
+    {
+        cerr << "No se pudo abrir el archivo: " << programPath << endl;
+        return false;
+    }
+    std::string_view text = program.text();
+
+    if (segmenter != nullptr)
+    {
+        for (auto segmentText : segmenter->split(text))
+        {
+            auto pages = paginationView(segmentText, pageSize);
+            if (!onSegment(pages))
+            {
+                break;
+            }
+        }
+        return true;
+    }
+
+    // En los textos grandes los saltos de línea se cuentan por trozos en paralelo y los
+    // cortes entre partes se buscan solo en el trozo donde caen
+    bool chunked = paginateInParallel(text.size());
+    vector<size_t> chunkNewlines;
+    size_t newlines = 0;
+    if (chunked)
+    {
+        chunkNewlines = countNewlinesByChunk(text);
+        for (size_t count : chunkNewlines)
+        {
+            newlines += count;
+        }
+    }
+    else
+    {
+        newlines = countNewlines(text);
+    }
+
+    // Como con getline, la última línea puede no terminar en salto de línea
+    size_t lines = newlines + (!text.empty() && text.back() != '\n' ? 1 : 0);
+    size_t segmentSize = static_cast<size_t>(ceil(lines / 3.0)); // Número de líneas por parte
+    size_t fullSegments = segmentSize > 0 ? lines / segmentSize : 0;
+
+    // Las partes completas se paginan como un solo texto con sus saltos de línea
+    size_t position = 0;
+    for (size_t part = 0; part < fullSegments; ++part)
+    {
+        size_t begin = position;
+        position = chunked ? positionAfterNewline(text, chunkNewlines, (part + 1) * segmentSize) : skipLines(text, position, segmentSize);
+        auto pages = paginationView(text.substr(begin, position - begin), pageSize);
+
+        // segmentProgram termina cada línea con "\n": si el archivo no lo tiene al final,
+        // la última página es la única que se copia
+        if (text[position - 1] != '\n')
+        {
+            if (pages.back().size() < static_cast<size_t>(pageSize))
+            {
+                pages.back() = program.keep(std::string(pages.back()) + "\n");
+            }
+            else
+            {
+                pages.push_back(program.keep("\n"));
+            }
+        }
+        if (!onSegment(pages))
+        {
+            return true;
+        }
+    }
+
+    // Procesar la última parte si quedó incompleta: cada línea se pagina por separado
+    if (position < text.size())
+    {
+        auto pages = paginateLinesChunked(text.substr(position));
+        onSegment(pages);
+    }
+
+    return true;
+}
+
+// Segmenta con la estrategia configurada en programSegmenter
+bool segmentProgramStreaming(const string &programPath, MappedProgram &program, const std::function<bool(vector<string_view> &)> &onSegment)
+{
+    return segmentProgramStreaming(programPath, program, onSegment, programSegmenter.get());
+}
+
+// Igual que segmentProgram pero sin copiar el programa: los segmentos y las páginas son
+// vistas sobre la proyección del archivo
+bool segmentProgram(const string &programPath, MappedProgram &program, vector<vector<string_view>> &segment)
+{
+    return segmentProgramStreaming(programPath, program, [&segment](vector<string_view> &pages)
+                                   {
+        segment.push_back(std::move(pages));
+        return true; });
+}
+
+// Segmenta el programa con la estrategia indicada (nullptr = la original) y cuenta las
+// páginas que produce y los bytes que quedan sin usar en ellas
+SegmentationReport evaluateSegmenter(const std::shared_ptr<const Segmenter> &segmenter, const string &programPath)
+{
+    SegmentationReport report;
+    report.strategy = segmenter ? segmenter->name() : "Original (3 partes)";
+
+    MappedProgram program;
+    segmentProgramStreaming(programPath, program, [&report](vector<string_view> &pages)
+                            {
+        report.segments++;
+        for (auto page : pages)
+        {
+            report.pages++;
+            report.bytes += page.size();
+            report.fragmentation += static_cast<size_t>(pageSize) - page.size();
+        }
+        return true; }, segmenter.get());
+    return report;
+}
+
+// Muestra las páginas y la fragmentación interna de cada estrategia con el programa
+void compareSegmenters(const string &programPath)
+{
+    std::vector<std::shared_ptr<const Segmenter>> segmenters = {
+        nullptr,
+        std::make_shared<EqualSegmentsSegmenter>(3),
+        std::make_shared<FixedLinesSegmenter>(10),
+        std::make_shared<FixedBytesSegmenter>(static_cast<size_t>(pageSize) * 8),
+        std::make_shared<FunctionSegmenter>(),
+        std::make_shared<FunctionSegmenter>(static_cast<size_t>(pageSize) * 4)};
+
+    for (const auto &segmenter : segmenters)
+    {
+        SegmentationReport report = evaluateSegmenter(segmenter, programPath);
+        double wasted = report.pages > 0 ? 100.0 * report.fragmentation / (report.pages * static_cast<double>(pageSize)) : 0.0;
+        cout << report.strategy
+             << " | Segmentos: " << report.segments
+             << " | Páginas: " << report.pages
+             << " | Fragmentación interna: " << report.fragmentation << " bytes (" << wasted << "%)" << endl;
+    }
+}
+
+// Carga el programa de filePath en el proceso. Cada segmento recibe sus frames en cuanto
+// el segmentador lo entrega; la tabla solo se publica cuando están todos. Si el proceso ya
+// existía, su tabla se sustituye (y se liberan sus frames) al publicar la nueva; si la
+// carga falla, sigue como estaba.
+bool memoryAllocation(int process_id) // solo pid
+{
+    SharedImageTransaction transaction({process_id}, true);
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    auto table = std::make_shared<ProcessTable>();
+    table->process_id = process_id;
+    MappedProgram program;
+    bool loaded = true;
+    bool read = segmentProgramStreaming(filePath, program, [&](vector<string_view> &pages)
+                                        {
+        // La tabla aún no es visible: sus frames solo los toca este hilo
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        loaded = loadSegment(*table, pages);
+        return loaded; });
+
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        loaded = loaded && read && (!sharedImage.attached() || sharedImage.publishProcess(*table));
+        if (loaded)
+        {
+            // Otra carga del mismo proceso pudo publicarse mientras tanto: también se sustituye
+            auto previous = pageTables.find(process_id);
+            if (previous != pageTables.end())
+            {
+                releaseProcessFramesLocked(*previous->second);
+            }
+            pageTables[process_id] = table;
+        }
+        else
+        {
+            releaseTableFrames(*table);
+        }
+        ramImageModified = true;
+    }
+    if (!read)
+    {
+        return {};
+    }
+    if (!loaded)
+    {
+        return false;
+    }
+
+    if (writeThroughPersistence)
+    {
+        persistMemoryImage();
+        std::cout << "JSON principal y secundario actualizados correctamente." << std::endl;
+    }
+    return true;
+}
+
+// Crea child_pid como copia de parent_pid sin duplicar su memoria (como fork en Unix): se
+// clona la tabla de páginas y las páginas del hijo comparten los frames de RAM y Swap del
+// padre, contados como referencias extra en los índices de deduplicación. La primera
+// escritura de cualquiera de los dos copia la página (ver makePagePrivateLocked).
+// Una página compartida tiene que estar limpia, así que las sucias del padre se escriben
+// antes en Swap. El hijo no hereda las fijaciones: las páginas fijadas del padre no se
+// comparten en RAM y el hijo las carga de Swap si las usa.
+bool forkProcess(int parent_pid, int child_pid)
+{
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+    if (parent_pid == child_pid)
+    {
+        cerr << "El proceso hijo necesita un process_id distinto del padre: " << child_pid << endl;
+        return false;
+    }
+
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        if (sharedImage.attached())
+        {
+            cerr << "No se pueden clonar procesos con la imagen compartida" << endl;
+            return false;
+        }
+        ProcessTable *parent = findProcess(parent_pid);
+        if (parent == nullptr)
+        {
+            cerr << "El proceso " << parent_pid << " no existe" << endl;
+            return false;
+        }
+        releaseProcessLocked(child_pid);
+
+        for (auto &segmentTable : parent->segments)
+        {
+            for (auto &entry : segmentTable.pages)
+            {
+                if (entry.presence_bit && entry.dirty_bit)
+                {
+                    setSwapPageContent(entry.frame_swap, ramPageContent(entry.frame_ram));
+                    entry.dirty_bit = false;
+                    swapImageModified = true;
+                }
+            }
+        }
+
+        auto child = std::make_shared<ProcessTable>();
+        child->process_id = child_pid;
+        child->segments = parent->segments;
+        long long shared = 0;
+        {
+            std::lock_guard<std::mutex> dedupLock(dedupMutex);
+            for (auto &segmentTable : child->segments)
+            {
+                for (auto &entry : segmentTable.pages)
+                {
+                    FrameUser user{child_pid, segmentTable.segment_id, entry.page_number};
+                    if (entry.frame_swap >= 0)
+                    {
+                        swapContentIndex.addSharer(entry.frame_swap, user);
+                    }
+                    if (entry.presence_bit && entry.pin_count == 0)
+                    {
+                        ramContentIndex.addSharer(entry.frame_ram, user);
+                    }
+                    else
+                    {
+                        entry.frame_ram = -1;
+                        entry.presence_bit = false;
+                    }
+                    entry.pin_count = 0;
+                    shared++;
+                }
+                rebuildEvictable(segmentTable);
+            }
+        }
+
+        pageTables[child_pid] = child;
+        ramImageModified = true;
+        dedupStats.forks++;
+        dedupStats.fork_shared_pages += shared;
+    }
+
+    if (writeThroughPersistence)
+    {
+        persistMemoryImage();
+        std::cout << "JSON principal y secundario actualizados correctamente." << std::endl;
+    }
+    return true;
+}
+
+// Carga varios programas a la vez: los hilos del grupo de paginación leen, segmentan y
+// cargan cada programa en una tabla nueva que aún no es visible, y al final se publican
+// todas en un solo paso, con la imagen bloqueada. Si algún programa no se puede leer o no
+// cabe, solo se liberan las tablas nuevas: los procesos que ya existían con esos
+// process_id siguen como estaban.
+bool memoryAllocationBatch(const vector<pair<int, string>> &programs)
+{
+    vector<int> process_ids;
+    for (const auto &program : programs)
+    {
+        process_ids.push_back(program.first);
+    }
+    SharedImageTransaction transaction(process_ids, true);
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    vector<std::shared_ptr<ProcessTable>> tables(programs.size());
+    std::atomic<bool> readOk{true};
+    std::atomic<bool> loaded{true};
+    paginationPool().forEachChunk(programs.size(), [&](size_t i)
+                                  {
+        auto table = std::make_shared<ProcessTable>();
+        table->process_id = programs[i].first;
+        tables[i] = table;
+        MappedProgram program;
+        bool read = segmentProgramStreaming(programs[i].second, program, [&](vector<string_view> &pages)
+                                            {
+            // La tabla aún no es visible: sus frames solo los toca este hilo. Si otro
+            // programa del lote ya no cupo, no se sigue cargando
+            std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+            if (loaded && !loadSegment(*table, pages))
+            {
+                loaded = false;
+            }
+            return loaded.load(); });
+        if (!read)
+        {
+            readOk = false;
+        } });
+
+    {
+        std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+        // Con la imagen compartida cada tabla se publica en la región; si una falla, las
+        // ya publicadas vuelven a la tabla anterior del proceso
+        size_t published = 0;
+        bool ok = readOk && loaded;
+        for (; ok && sharedImage.attached() && published < tables.size(); ++published)
+        {
+            ok = sharedImage.publishProcess(*tables[published]);
+        }
+        if (!ok)
+        {
+            for (size_t i = 0; sharedImage.attached() && i < published; ++i)
+            {
+                auto previous = pageTables.find(tables[i]->process_id);
+                if (previous == pageTables.end() || !sharedImage.publishProcess(*previous->second))
+                {
+                    sharedImage.unpublishProcess(tables[i]->process_id);
+                }
+            }
+            for (auto &table : tables)
+            {
+                releaseTableFrames(*table);
+            }
+            ramImageModified = true;
+            return false;
+        }
+
+        for (auto &table : tables)
+        {
+            auto previous = pageTables.find(table->process_id);
+            if (previous != pageTables.end())
+            {
+                releaseProcessFramesLocked(*previous->second);
+            }
+            pageTables[table->process_id] = table;
+        }
+        ramImageModified = true;
+    }
+
+    if (writeThroughPersistence)
+    {
+        persistMemoryImage();
+        std::cout << "JSON principal y secundario actualizados correctamente." << std::endl;
+    }
+    return true;
+}
+
+// Copia en content un frame de Swap para atender un fallo: primero lo busca en la caché
+// comprimida y si no está lo lee del Swap (descomprimido si el Swap está comprimido).
+// Devuelve false si el frame no existe o su contenido está dañado: la página no se carga.
+// El llamador tiene el lock del proceso dueño.
+bool getPage(int frame_number, std::string &content)
+{
+    if (frame_number < 0 || frame_number >= static_cast<int>(swapFrames.size()))
+    {
+        return false;
+    }
+    if (compressedPageCache.enabled())
+    {
+        if (compressedPageCache.load(frame_number, content))
+        {
+            pageCacheStats.hits++;
+            return true;
+        }
+        pageCacheStats.misses++;
+    }
+    return readSwapBacking(frame_number, content);
+}
+
+// Marca la página como presente en el frame de RAM indicado.
+// El llamador tiene imageMutex y el lock del proceso.
+void updateTable(int segmento, int pagina, int process_id, int new_page_ram_frame)
+{
+    ProcessTable *table = findProcess(process_id);
+    if (table == nullptr)
+    {
+        return;
+    }
+
+    PageTableEntry *entry = findPage(*table, segmento, pagina);
+    if (entry != nullptr)
+    {
+        entry->frame_ram = new_page_ram_frame;
+        entry->presence_bit = true;
+        entry->dirty_bit = false; // Recién cargada: coincide con Swap
+        pageEntryChanged(*table, *findSegment(*table, segmento), *entry);
+        ramImageModified = true;
+    }
+}
+
+// Saca una página de RAM sin soltar todavía su frame: invalida la TLB, la guarda en la
+// caché comprimida si está activa y si no la escribe en Swap solo si está sucia (una
+// página sucia nunca comparte frames).
+// El llamador tiene el lock del proceso. Devuelve el frame que queda por soltar con dropRamFrame.
+int detachPageLocked(ProcessTable &table, int segment, PageTableEntry &entry)
+{
+    table.tlb.invalidatePage(table.process_id, segment, entry.page_number);
+
+    int frame_number = entry.frame_ram;
+    std::string_view content = ramPageContent(frame_number);
+    if (entry.dirty_bit)
+    {
+        evictionStats.dirty_evictions++;
+        if (!compressedPageCache.store(entry.frame_swap, content, true))
+        {
+            evictionStats.bytes_written_back += content.size();
+            setSwapPageContent(entry.frame_swap, content);
+        }
+        swapImageModified = true;
+    }
+    else
+    {
+        evictionStats.clean_evictions++;
+        evictionStats.bytes_saved += content.size();
+        compressedPageCache.store(entry.frame_swap, content, false);
+    }
+
+    entry.frame_ram = -1;
+    entry.presence_bit = false;
+    entry.dirty_bit = false;
+    pageEntryChanged(table, *findSegment(table, segment), entry);
+    ramImageModified = true;
+    return frame_number;
+}
+
+// Último proceso visitado por el reloj del reclamador
+std::atomic<int> reclaimHand{0};
+
+// Desaloja hasta target páginas residentes no fijadas de cualquier proceso con el algoritmo
+// del reloj, recorriendo solo las listas de desalojables de cada segmento. Cada llamada es
+// una vuelta que sigue desde el último proceso visitado. Una página con traducción en la
+// TLB de su proceso se usó hace poco y tiene una segunda oportunidad: se invalida la
+// traducción y solo se desaloja en una vuelta posterior si para entonces no se ha vuelto a
+// usar. Los procesos ocupados con otra operación se saltan.
+// El llamador tiene imageMutex y, si held no es nullptr, el lock de ese proceso.
+// Devuelve el número de páginas desalojadas.
+size_t reclaimPagesLocked(size_t target, ProcessTable *held)
+{
+    std::vector<ProcessTable *> tables;
+    for (auto &process : pageTables)
+    {
+        tables.push_back(process.second.get());
+    }
+    std::sort(tables.begin(), tables.end(), [](const ProcessTable *a, const ProcessTable *b)
+              { return a->process_id < b->process_id; });
+
+    // Seguir por el proceso siguiente al último visitado
+    int hand = reclaimHand.load();
+    auto next = std::find_if(tables.begin(), tables.end(), [hand](const ProcessTable *table)
+                             { return table->process_id > hand; });
+    std::rotate(tables.begin(), next, tables.end());
+
+    size_t evicted = 0;
+    for (ProcessTable *table : tables)
+    {
+        // Con la imagen compartida también hace falta el lock del proceso en la región
+        // (el de held ya lo tiene este hilo); antes de tocar la tabla se pone al día
+        SharedProcessTryLock sharedLock(table->process_id);
+        std::unique_lock<std::mutex> processLock(table->lock, std::defer_lock);
+        if (!sharedLock.owns() || (table != held && !processLock.try_lock()))
+        {
+            continue;
+        }
+        if (sharedLock.index() != -1)
+        {
+            syncSharedProcessLocked(*table, sharedLock.index());
+        }
+
+        reclaimHand = table->process_id;
+        for (auto &segmentTable : table->segments)
+        {
+            forEachEvictable(segmentTable, [&](PageTableEntry &entry)
+                             {
+                if (table->tlb.contains(table->process_id, segmentTable.segment_id, entry.page_number))
+                {
+                    table->tlb.invalidatePage(table->process_id, segmentTable.segment_id, entry.page_number);
+                    return true;
+                }
+                dropRamFrame(detachPageLocked(*table, segmentTable.segment_id, entry), {table->process_id, segmentTable.segment_id, entry.page_number});
+                return ++evicted < target; });
+            if (evicted >= target)
+            {
+                return evicted;
+            }
+        }
+    }
+    return evicted;
+}
+
+// Frames de RAM que corresponden a un porcentaje (al menos 1). El llamador tiene imageMutex.
+size_t reclaimWatermark(int percent)
+{
+    return std::max<size_t>(1, ramFrames.size() * static_cast<size_t>(std::max(percent, 0)) / 100);
+}
+
+// Reclamador en segundo plano (como kswapd de Linux): cuando los frames libres de RAM bajan
+// de la marca baja desaloja páginas hasta llegar a la alta, así casi todos los fallos
+// encuentran un frame libre sin tener que elegir víctimas.
+class BackgroundReclaimer
+{
+public:
+    ~BackgroundReclaimer()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        if (thread.joinable())
+        {
+            return;
+        }
+        stopping = false;
+        running = true;
+        thread = std::thread([this]
+                             { loop(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> stateLock(stateMutex);
+            if (!thread.joinable())
+            {
+                return;
+            }
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        thread.join();
+        running = false;
+    }
+
+    bool isRunning() const
+    {
+        return running.load(std::memory_order_acquire);
+    }
+
+    // Lo llaman los fallos cuando ven los frames libres por debajo de la marca baja.
+    // Si ya hay un aviso pendiente no se vuelve a notificar.
+    void wake()
+    {
+        if (wakeRequested.load(std::memory_order_relaxed) || wakeRequested.exchange(true))
+        {
+            return;
+        }
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        wakeUp.notify_one();
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> stateLock(stateMutex);
+        while (!stopping)
+        {
+            // Además de los avisos se revisan las marcas periódicamente
+            wakeUp.wait_for(stateLock, std::chrono::milliseconds(50), [this]
+                            { return stopping || wakeRequested; });
+            if (stopping)
+            {
+                break;
+            }
+            wakeRequested = false;
+            stateLock.unlock();
+            reclaimToHighWatermark();
+            stateLock.lock();
+        }
+    }
+
+    void reclaimToHighWatermark()
+    {
+        if (!imageLoaded)
+        {
+            return;
+        }
+
+        SharedImageTransaction transaction;
+        if (!ensureMemoryImage())
+        {
+            return;
+        }
+
+        size_t evicted = 0;
+        {
+            std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+            size_t available = ramPool.available();
+            if (available >= reclaimWatermark(reclaimLowPercent))
+            {
+                return;
+            }
+            reclaimStats.wakeups++;
+            size_t high = reclaimWatermark(reclaimHighPercent);
+            if (high > available)
+            {
+                evicted = reclaimPagesLocked(high - available, nullptr);
+            }
+            reclaimStats.background_reclaims += evicted;
+        }
+
+        // Los frames liberados no se quedan en el magazine de este hilo
+        flushThreadMagazines();
+        if (evicted > 0)
+        {
+            persistIfWriteThrough();
+        }
+    }
+
+    std::mutex stateMutex;
+    std::condition_variable wakeUp;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    bool stopping = false;
+    std::atomic<bool> wakeRequested{false};
+};
+
+// Reclamador compartido, se crea la primera vez que se usa
+BackgroundReclaimer &reclaimer()
+{
+    static BackgroundReclaimer instance;
+    return instance;
+}
+
+// Proceso y página (en orden de la tabla) donde sigue el escáner de duplicados.
+// dedupScanMutex los protege: dos pasadas del escáner no se solapan.
+std::mutex dedupScanMutex;
+int dedupCursorProcess = 0;
+size_t dedupCursorPage = 0;
+
+// Revisa hasta budget páginas limpias y no fijadas, siguiendo por donde quedó la pasada
+// anterior. El frame de cada página (en RAM y en Swap) se fusiona con el frame indexado
+// del mismo contenido si lo hay; si no, se indexa. Las páginas sucias se saltan: su copia
+// en Swap está desactualizada y van a cambiar. Un frame fijado no se usa como canónico.
+// El llamador tiene imageMutex (compartido basta): cada proceso se revisa con su lock y
+// dedupMutex se toma por página. Devuelve el número de frames fusionados.
+size_t mergeDuplicatePagesLocked(size_t budget)
+{
+    std::lock_guard<std::mutex> scanLock(dedupScanMutex);
+    std::vector<ProcessTable *> tables;
+    for (auto &process : pageTables)
+    {
+        tables.push_back(process.second.get());
+    }
+    if (tables.empty())
+    {
+        return 0;
+    }
+    std::sort(tables.begin(), tables.end(), [](const ProcessTable *a, const ProcessTable *b)
+              { return a->process_id < b->process_id; });
+    size_t start = std::find_if(tables.begin(), tables.end(), [](const ProcessTable *table)
+                                { return table->process_id >= dedupCursorProcess; }) -
+                   tables.begin();
+    if (start == tables.size() || tables[start]->process_id != dedupCursorProcess)
+    {
+        start %= tables.size();
+        dedupCursorPage = 0;
+    }
+
+    // Fusiona el frame de la página con el indexado del mismo contenido o lo indexa.
+    // Devuelve el frame que queda libre (o -1) para soltarlo sin dedupMutex.
+    auto mergeFrame = [](FrameContentIndex &index, std::vector<Frame> &frames, int &frame_number, const FrameUser &user, bool &merged)
+    {
+        merged = false;
+        if (index.indexed(frame_number))
+        {
+            return -1;
+        }
+        bool isRam = &frames == &ramFrames;
+        int canonical = index.find(isRam ? ramFrames[frame_number].content : swapPageContent(frame_number));
+        if (canonical == -1)
+        {
+            index.insert(frame_number);
+            return -1;
+        }
+        if (isRam && ramFrames[canonical].pin_count > 0)
+        {
+            return -1;
+        }
+        index.addSharer(canonical, user);
+        int released = dropFrameReference(index, frames, frame_number, user) ? frame_number : -1;
+        frame_number = canonical;
+        merged = true;
+        return released;
+    };
+
+    size_t scanned = 0;
+    size_t merged = 0;
+    auto finish = [&]()
+    {
+        if (merged > 0)
+        {
+            ramImageModified = true;
+        }
+        dedupStats.scan_merges += merged;
+        return merged;
+    };
+    // La última vuelta vuelve al primer proceso para revisar las páginas anteriores al cursor
+    for (size_t n = 0; n <= tables.size(); ++n)
+    {
+        ProcessTable &table = *tables[(start + n) % tables.size()];
+        std::lock_guard<std::mutex> tableLock(table.lock);
+        size_t first = n == 0 ? dedupCursorPage : 0;
+        size_t last = n == tables.size() ? dedupCursorPage : SIZE_MAX;
+        size_t ordinal = 0;
+        for (auto &segmentTable : table.segments)
+        {
+            for (auto &entry : segmentTable.pages)
+            {
+                size_t position = ordinal++;
+                if (position < first || position >= last || entry.dirty_bit || entry.pin_count > 0)
+                {
+                    continue;
+                }
+                if (scanned++ == budget)
+                {
+                    dedupCursorProcess = table.process_id;
+                    dedupCursorPage = position;
+                    return finish();
+                }
+
+                FrameUser user{table.process_id, segmentTable.segment_id, entry.page_number};
+                int releasedSwap = -1;
+                int releasedRam = -1;
+                bool swapMerged = false;
+                bool ramMerged = false;
+                int frame_number = entry.frame_ram;
+                {
+                    std::lock_guard<std::mutex> dedupLock(dedupMutex);
+                    if (entry.frame_swap >= 0)
+                    {
+                        releasedSwap = mergeFrame(swapContentIndex, swapFrames, entry.frame_swap, user, swapMerged);
+                    }
+                    if (entry.presence_bit)
+                    {
+                        releasedRam = mergeFrame(ramContentIndex, ramFrames, frame_number, user, ramMerged);
+                    }
+                }
+                if (releasedSwap != -1)
+                {
+                    setSwapPageContent(releasedSwap, "");
+                    releaseSwapFrame(releasedSwap);
+                }
+                if (releasedRam != -1)
+                {
+                    setRamPageContent(releasedRam, ""); // Limpiar contenido
+                    releaseRamFrame(releasedRam);
+                }
+                if (swapMerged)
+                {
+                    swapImageModified = true;
+                    merged++;
+                }
+                if (ramMerged)
+                {
+                    table.tlb.invalidatePage(table.process_id, segmentTable.segment_id, entry.page_number);
+                    entry.frame_ram = frame_number;
+                    merged++;
+                }
+            }
+        }
+    }
+    return finish();
+}
+
+// Escáner de duplicados en segundo plano (como ksmd de Linux): cada cierto tiempo revisa
+// un lote de páginas y fusiona las que tienen el mismo contenido
+class DeduplicationScanner
+{
+public:
+    ~DeduplicationScanner()
+    {
+        stop();
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> stateLock(stateMutex);
+        if (thread.joinable())
+        {
+            return;
+        }
+        stopping = false;
+        thread = std::thread([this]
+                             { loop(); });
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> stateLock(stateMutex);
+            if (!thread.joinable())
+            {
+                return;
+            }
+            stopping = true;
+        }
+        wakeUp.notify_all();
+        thread.join();
+    }
+
+private:
+    void loop()
+    {
+        std::unique_lock<std::mutex> stateLock(stateMutex);
+        while (!stopping)
+        {
+            wakeUp.wait_for(stateLock, std::chrono::milliseconds(dedupScanIntervalMs.load()), [this]
+                            { return stopping; });
+            if (stopping)
+            {
+                break;
+            }
+            stateLock.unlock();
+            scan();
+            stateLock.lock();
+        }
+    }
+
+    void scan()
+    {
+        if (!imageLoaded || !pageDeduplication)
+        {
+            return;
+        }
+
+        SharedImageTransaction transaction;
+        if (!ensureMemoryImage())
+        {
+            return;
+        }
+
+        size_t merged;
+        {
+            std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+            merged = mergeDuplicatePagesLocked(dedupPagesPerScan);
+            dedupStats.scans++;
+        }
+
+        // Los frames liberados no se quedan en el magazine de este hilo
+        flushThreadMagazines();
+        if (merged > 0)
+        {
+            persistIfWriteThrough();
+        }
+    }
+
+    std::mutex stateMutex;
+    std::condition_variable wakeUp;
+    std::thread thread;
+    bool stopping = false;
+};
+
+// Escáner compartido, se crea la primera vez que se usa
+DeduplicationScanner &deduplicationScanner()
+{
+    static DeduplicationScanner instance;
+    return instance;
+}
+
+// Desaloja las páginas residentes no fijadas del segmento, salvo keep, para que sus
+// frames se puedan reutilizar. El llamador tiene imageMutex y el lock del proceso.
+void evictSegmentLocked(ProcessTable &table, int segment, const PageTableEntry *keep)
+{
+    SegmentTable *segmentTable = findSegment(table, segment);
+    if (segmentTable == nullptr)
+    {
+        return;
+    }
+    forEachEvictable(*segmentTable, [&](PageTableEntry &entry)
+                     {
+        if (&entry != keep)
+        {
+            dropRamFrame(detachPageLocked(table, segment, entry), {table.process_id, segment, entry.page_number});
+            reclaimStats.direct_reclaims++;
+        }
+        return true; });
+}
+
+// Atiende el fallo de una página y la carga desde Swap.
+// Con la deduplicación activa, si ya hay en RAM un frame indexado con el mismo contenido
+// la página lo comparte y no hace falta ningún frame libre.
+// Sin reclamador en segundo plano se desalojan antes las páginas residentes no fijadas del
+// mismo segmento. Con él, el fallo usa un frame libre si lo hay y solo desaloja (reclamo
+// directo) cuando no queda ninguno: primero en el segmento y después en cualquier proceso.
+// El llamador tiene imageMutex y el lock del proceso.
+bool swapInLocked(ProcessTable &table, int segment, int page)
+{
+    PageTableEntry *target = findPage(table, segment, page);
+    if (target == nullptr)
+    {
+        cerr << "La página " << page << " del segmento " << segment << " no existe para el proceso " << table.process_id << endl;
+        return false;
+    }
+
+    // La página ya está en RAM: no hay nada que cargar
+    if (target->presence_bit)
+    {
+        return true;
+    }
+
+    if (pageDeduplication.load(std::memory_order_relaxed))
+    {
+        std::unique_lock<std::mutex> dedupLock(dedupMutex);
+        int shared = ramContentIndex.find(swapPageContent(target->frame_swap));
+        if (shared != -1 && ramFrames[shared].pin_count == 0) // Un frame fijado no se comparte
+        {
+            ramContentIndex.addSharer(shared, {table.process_id, segment, page});
+            dedupLock.unlock();
+            dedupStats.fault_merges++;
+            updateTable(segment, page, table.process_id, shared);
+            return true;
+        }
+    }
+
+    // Se lee antes de desalojar nada: una página que no se puede leer no se carga
+    std::string content;
+    if (!getPage(target->frame_swap, content))
+    {
+        cerr << "No se pudo leer la página " << page << " del segmento " << segment << " del proceso " << table.process_id << " desde Swap" << endl;
+        return false;
+    }
+
+    auto evictSegment = [&]()
+    {
+        // Primero se liberan los frames de las páginas desalojadas para poder reutilizarlos
+        evictSegmentLocked(table, segment, target);
+    };
+
+    bool background = reclaimer().isRunning();
+    if (!background)
+    {
+        evictSegment();
+    }
+
+    int span = segmentPageFrames(table, segment);
+    int new_ram_frame_assigned = allocateRamFrame(table.process_id, segment, page, span);
+    if (background)
+    {
+        if (new_ram_frame_assigned != -1)
+        {
+            reclaimStats.faults_without_eviction++;
+        }
+        else
+        {
+            evictSegment();
+            new_ram_frame_assigned = allocateRamFrame(table.process_id, segment, page, span);
+            // Si la primera vuelta solo quita referencias, la segunda encuentra víctima
+            for (int pass = 0; pass < 2 && new_ram_frame_assigned == -1; ++pass)
+            {
+                size_t reclaimed = reclaimPagesLocked(span, &table);
+                if (reclaimed > 0)
+                {
+                    reclaimStats.direct_reclaims += reclaimed;
+                    new_ram_frame_assigned = allocateRamFrame(table.process_id, segment, page, span);
+                }
+            }
+        }
+        if (ramPool.available() < reclaimWatermark(reclaimLowPercent))
+        {
+            reclaimer().wake();
+        }
+    }
+    if (new_ram_frame_assigned == -1)
+    {
+        cerr << "Memoria RAM Insuficiente" << endl;
+        return false;
+    }
+
+    setRamPageContent(new_ram_frame_assigned, content);
+    if (pageDeduplication.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        ramContentIndex.insert(new_ram_frame_assigned);
+    }
+    updateTable(segment, page, table.process_id, new_ram_frame_assigned);
+    return true;
+}
+
+// Copia al escribir: deja la página con un frame de RAM propio (y, con withSwap, también
+// de Swap) antes de modificarla o fijarla. Un frame compartido se copia a uno nuevo; uno
+// propio sale del índice de contenido para que nadie lo comparta mientras cambia.
+// El llamador tiene imageMutex y el lock del proceso; la página está en RAM.
+// Devuelve false si no hay frames para la copia.
+bool makePagePrivateLocked(ProcessTable &table, int segment, PageTableEntry &entry, bool withSwap)
+{
+    if (!deduplicationActive())
+    {
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        ramContentIndex.erase(entry.frame_ram);
+        if (withSwap)
+        {
+            swapContentIndex.erase(entry.frame_swap);
+        }
+        if (ramContentIndex.sharers(entry.frame_ram) == 0 && (!withSwap || swapContentIndex.sharers(entry.frame_swap) == 0))
+        {
+            return true;
+        }
+    }
+
+    // Los frames para las copias se reservan sin dedupMutex: reservar puede desalojar
+    int ramCopy = -1;
+    int swapCopy = -1;
+    {
+        std::unique_lock<std::mutex> dedupLock(dedupMutex);
+        bool ramShared = ramContentIndex.sharers(entry.frame_ram) > 0;
+        bool swapShared = withSwap && swapContentIndex.sharers(entry.frame_swap) > 0;
+        dedupLock.unlock();
+        int span = segmentPageFrames(table, segment);
+        if (ramShared)
+        {
+            ramCopy = allocateRamFrame(table.process_id, segment, entry.page_number, span);
+            if (ramCopy == -1)
+            {
+                evictSegmentLocked(table, segment, &entry);
+                ramCopy = allocateRamFrame(table.process_id, segment, entry.page_number, span);
+            }
+        }
+        if (swapShared)
+        {
+            swapCopy = allocateSwapFrame(table.process_id, segment, entry.page_number, span);
+        }
+        if ((ramShared && ramCopy == -1) || (swapShared && swapCopy == -1))
+        {
+            cerr << (ramShared && ramCopy == -1 ? "Memoria RAM Insuficiente" : "Memoria Swap Insuficiente") << endl;
+            if (ramCopy != -1)
+            {
+                releaseRamFrame(ramCopy);
+            }
+            if (swapCopy != -1)
+            {
+                releaseSwapFrame(swapCopy);
+            }
+            return false;
+        }
+    }
+
+    // Las otras páginas pueden haber soltado el frame mientras tanto: entonces ya es propio
+    std::lock_guard<std::mutex> dedupLock(dedupMutex);
+    if (ramCopy != -1)
+    {
+        if (ramContentIndex.sharers(entry.frame_ram) > 0)
+        {
+            ramFrames[ramCopy].content = ramFrames[entry.frame_ram].content;
+            dropFrameReference(ramContentIndex, ramFrames, entry.frame_ram, {table.process_id, segment, entry.page_number});
+            table.tlb.invalidatePage(table.process_id, segment, entry.page_number);
+            entry.frame_ram = ramCopy;
+            dedupStats.cow_copies++;
+        }
+        else
+        {
+            releaseRamFrame(ramCopy);
+        }
+        ramImageModified = true;
+    }
+    if (swapCopy != -1)
+    {
+        if (swapContentIndex.sharers(entry.frame_swap) > 0)
+        {
+            setSwapPageContent(swapCopy, swapPageContent(entry.frame_swap));
+            dropFrameReference(swapContentIndex, swapFrames, entry.frame_swap, {table.process_id, segment, entry.page_number});
+            entry.frame_swap = swapCopy;
+            dedupStats.cow_copies++;
+        }
+        else
+        {
+            releaseSwapFrame(swapCopy);
+        }
+        swapImageModified = true;
+    }
+    return true;
+}
+
+bool memorySwap(int segment, int page, int process_id)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    bool swapped;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        if (table == nullptr)
+        {
+            cerr << "La página " << page << " del segmento " << segment << " no existe para el proceso " << process_id << endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> processLock(table->lock);
+        swapped = swapInLocked(*table, segment, page);
+    }
+
+    persistIfWriteThrough();
+    return swapped;
+}
+
+// Página solicitada en un lote de fallos
+struct PageRequest
+{
+    int process_id;
+    int segment;
+    int page;
+};
+
+// Carga en RAM todas las páginas solicitadas eligiendo víctimas y frames en una sola pasada.
+// Sigue la política de memorySwap: en cada segmento afectado se desalojan las páginas
+// residentes no fijadas que no forman parte del lote (con el reclamador en segundo plano,
+// solo las que hagan falta para tener frames). Los frames se reservan antes de desalojar:
+// si alguna página no existe, o si ni desalojando las víctimas hay frames para todas, no se
+// carga ni se desaloja ninguna y devuelve false. Solo si otro hilo se lleva los frames que
+// liberan las víctimas puede fallar con parte de ellas ya desalojadas (siguen en Swap).
+bool memorySwapBatch(const vector<PageRequest> &requests)
+{
+    vector<int> process_ids;
+    for (const auto &request : requests)
+    {
+        process_ids.push_back(request.process_id);
+    }
+    SharedImageTransaction transaction(process_ids);
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    bool swapped = true;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+
+        // Páginas pedidas agrupadas por proceso y segmento; el map deja los procesos en orden ascendente
+        std::map<int, std::map<int, std::set<int>>> requested;
+        for (const auto &request : requests)
+        {
+            requested[request.process_id][request.segment].insert(request.page);
+        }
+
+        auto reportMissing = [](int process_id, int segment, int page)
+        {
+            cerr << "La página " << page << " del segmento " << segment << " no existe para el proceso " << process_id << endl;
+            return false;
+        };
+
+        vector<std::unique_lock<std::mutex>> processLocks;
+        vector<ProcessTable *> tables;
+        for (const auto &process : requested)
+        {
+            ProcessTable *table = findProcess(process.first);
+            if (table == nullptr)
+            {
+                const auto &segment = *process.second.begin();
+                return reportMissing(process.first, segment.first, *segment.second.begin());
+            }
+            processLocks.emplace_back(table->lock);
+            tables.push_back(table);
+        }
+
+        // Página del lote, para cargarla o desalojarla; span son los frames que ocupa
+        struct BatchPage
+        {
+            ProcessTable *table;
+            int segment;
+            PageTableEntry *entry;
+            int span;
+        };
+        vector<BatchPage> victims;
+        vector<BatchPage> toLoad;
+        size_t framesNeeded = 0;
+        size_t victimFrames = 0;
+
+        // Una sola pasada por las tablas para elegir las páginas a cargar y los desalojos
+        for (ProcessTable *table : tables)
+        {
+            for (const auto &segmentPages : requested[table->process_id])
+            {
+                int segment = segmentPages.first;
+                const auto &wanted = segmentPages.second;
+                if (segment < 1 || segment > static_cast<int>(table->segments.size()) ||
+                    table->segments[segment - 1].segment_id != segment)
+                {
+                    return reportMissing(table->process_id, segment, *wanted.begin());
+                }
+
+                int span = segmentPageFrames(*table, segment);
+                for (int page : wanted)
+                {
+                    PageTableEntry *entry = findPage(*table, segment, page);
+                    if (entry == nullptr)
+                    {
+                        return reportMissing(table->process_id, segment, page);
+                    }
+                    if (!entry->presence_bit)
+                    {
+                        toLoad.push_back({table, segment, entry, span});
+                        framesNeeded += static_cast<size_t>(span);
+                    }
+                }
+                forEachEvictable(table->segments[segment - 1], [&](PageTableEntry &entry)
+                                 {
+                    if (wanted.count(entry.page_number) == 0)
+                    {
+                        victims.push_back({table, segment, &entry, span});
+                        victimFrames += static_cast<size_t>(span);
+                    }
+                    return true; });
+            }
+        }
+
+        // Se leen antes de tocar nada: si alguna página no se puede leer no se carga el lote
+        vector<std::string> contents(toLoad.size());
+        for (size_t i = 0; i < toLoad.size(); ++i)
+        {
+            if (!getPage(toLoad[i].entry->frame_swap, contents[i]))
+            {
+                cerr << "No se pudo leer la página " << toLoad[i].entry->page_number << " del segmento " << toLoad[i].segment
+                     << " del proceso " << toLoad[i].table->process_id << " desde Swap" << endl;
+                return false;
+            }
+        }
+
+        // Se reservan primero los frames libres; las víctimas solo se desalojan cuando faltan
+        // frames, y si ni con ellas alcanzan no se toca nada
+        size_t nextVictim = 0;
+        auto evictNextVictim = [&]()
+        {
+            const BatchPage &victim = victims[nextVictim++];
+            dropRamFrame(detachPageLocked(*victim.table, victim.segment, *victim.entry), {victim.table->process_id, victim.segment, victim.entry->page_number});
+            reclaimStats.direct_reclaims++;
+        };
+
+        vector<int> newFrames;
+        swapped = ramPool.available() + victimFrames >= framesNeeded;
+        for (size_t i = 0; swapped && i < toLoad.size(); ++i)
+        {
+            const BatchPage &load = toLoad[i];
+            int frame_number = allocateRamFrame(load.table->process_id, load.segment, load.entry->page_number, load.span);
+            while (frame_number == -1 && nextVictim < victims.size())
+            {
+                evictNextVictim();
+                frame_number = allocateRamFrame(load.table->process_id, load.segment, load.entry->page_number, load.span);
+            }
+            if (frame_number == -1)
+            {
+                swapped = false;
+                break;
+            }
+            newFrames.push_back(frame_number);
+        }
+
+        if (!swapped)
+        {
+            cerr << "Memoria RAM Insuficiente" << endl;
+            for (int frame_number : newFrames)
+            {
+                releaseRamFrame(frame_number);
+            }
+        }
+        else
+        {
+            // Sin reclamador, como en memorySwap, salen también las demás víctimas
+            if (!reclaimer().isRunning())
+            {
+                while (nextVictim < victims.size())
+                {
+                    evictNextVictim();
+                }
+            }
+
+            // Copiar todos los frames de Swap y actualizar las tablas de una vez
+            for (size_t i = 0; i < toLoad.size(); ++i)
+            {
+                PageTableEntry &entry = *toLoad[i].entry;
+                setRamPageContent(newFrames[i], contents[i]);
+                entry.frame_ram = newFrames[i];
+                entry.presence_bit = true;
+                entry.dirty_bit = false;
+                pageEntryChanged(*toLoad[i].table, toLoad[i].table->segments[toLoad[i].segment - 1], entry);
+            }
+            ramImageModified = true;
+        }
+    }
+
+    persistIfWriteThrough();
+    return swapped;
+}
+
+// Resultado de traducir una dirección lógica
+struct ResolvedAddress
+{
+    int page_number;
+    int frame_ram;
+    size_t page_offset; // Desplazamiento dentro de la página
+};
+
+// Resuelve la dirección lógica (segmento, desplazamiento) al frame de RAM que la contiene.
+// Primero se consulta la TLB del proceso; si falla se recorre la tabla de páginas y, si la
+// página no está en RAM, se atiende el fallo. El llamador tiene imageMutex y el lock del proceso.
+// faulted indica si hubo que cargar la página.
+bool resolveAddressLocked(ProcessTable &table, int segment, size_t offset, ResolvedAddress &address, bool &faulted)
+{
+    size_t pageBytes = segmentPageSize(table, segment);
+    if (const TLBEntry *hit = table.tlb.lookup(table.process_id, segment, offset, pageBytes))
+    {
+        address = {hit->page_number, hit->frame_ram, offset - hit->offset};
+        return true;
+    }
+
+    PageTableEntry *entry = translate(table, segment, offset);
+    if (entry == nullptr)
+    {
+        cerr << "Dirección lógica inválida: proceso " << table.process_id << ", segmento " << segment << ", desplazamiento " << offset << endl;
+        return false;
+    }
+
+    if (!entry->presence_bit)
+    {
+        // Fallo de página: cargar desde Swap
+        if (!swapInLocked(table, segment, entry->page_number))
+        {
+            return false;
+        }
+        faulted = true;
+    }
+
+    table.tlb.insert(table.process_id, segment, offset, *entry, pageBytes);
+    address = {entry->page_number, entry->frame_ram, offset - entry->offset};
+    return true;
+}
+
+// Lanza el error de una dirección que resolveAddressLocked no pudo resolver:
+// std::out_of_range si no pertenece al proceso y std::runtime_error si su página no se
+// pudo cargar en RAM. El llamador tiene el lock del proceso.
+[[noreturn]] void throwUnresolvedAddress(ProcessTable &table, int segment, size_t offset)
+{
+    if (translate(table, segment, offset) == nullptr)
+    {
+        throw std::out_of_range("Dirección lógica inválida");
+    }
+    throw std::runtime_error("Memoria RAM Insuficiente");
+}
+
+// Devuelve la página que contiene la dirección lógica del proceso.
+// La vista es válida hasta la siguiente operación que modifique la memoria; con
+// varios hilos conviene usar accessMemory, que copia el byte con el lock tomado.
+// Lanza std::out_of_range si la dirección no es válida y std::runtime_error si la
+// página no se puede cargar en RAM (lo mismo que accessMemory).
+std::string_view accessPage(int process_id, int segment, size_t offset)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        throw std::runtime_error("No se pudo cargar la imagen de memoria");
+    }
+
+    std::string_view page;
+    bool faulted = false;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        if (table == nullptr)
+        {
+            throw std::out_of_range("Dirección lógica inválida");
+        }
+
+        std::lock_guard<std::mutex> processLock(table->lock);
+        ResolvedAddress address;
+        if (!resolveAddressLocked(*table, segment, offset, address, faulted))
+        {
+            throwUnresolvedAddress(*table, segment, offset);
+        }
+        page = ramPageContent(address.frame_ram);
+    }
+
+    if (faulted)
+    {
+        persistIfWriteThrough();
+    }
+    return page;
+}
+
+// Devuelve el byte de la dirección lógica (segmento, desplazamiento) del proceso.
+// Lanza std::out_of_range si la dirección no es válida y std::runtime_error si la
+// página no se puede cargar en RAM.
+char accessMemory(int process_id, int segment, size_t offset)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        throw std::runtime_error("No se pudo cargar la imagen de memoria");
+    }
+
+    char value;
+    bool faulted = false;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        if (table == nullptr)
+        {
+            throw std::out_of_range("Dirección lógica inválida");
+        }
+
+        std::lock_guard<std::mutex> processLock(table->lock);
+        ResolvedAddress address;
+        if (!resolveAddressLocked(*table, segment, offset, address, faulted))
+        {
+            throwUnresolvedAddress(*table, segment, offset);
+        }
+        std::string_view content = ramPageContent(address.frame_ram);
+        if (address.page_offset >= content.size())
+        {
+            throw std::out_of_range("Dirección lógica inválida");
+        }
+        value = content[address.page_offset];
+    }
+
+    if (faulted)
+    {
+        persistIfWriteThrough();
+    }
+    return value;
+}
+
+// Lee el byte de la dirección lógica sin atender fallos de página. Devuelve false si la
+// dirección no es válida; si la página no está en RAM deja su número en faultPage y si se
+// pudo leer deja faultPage en -1.
+bool tryAccessMemory(int process_id, int segment, size_t offset, char &value, int &faultPage)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+    ProcessTable *table = findProcess(process_id);
+    if (table == nullptr)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> processLock(table->lock);
+    int frame_ram;
+    size_t page_offset;
+    size_t pageBytes = segmentPageSize(*table, segment);
+    if (const TLBEntry *hit = table->tlb.lookup(process_id, segment, offset, pageBytes))
+    {
+        frame_ram = hit->frame_ram;
+        page_offset = offset - hit->offset;
+    }
+    else
+    {
+        PageTableEntry *entry = translate(*table, segment, offset);
+        if (entry == nullptr)
+        {
+            return false;
+        }
+        if (!entry->presence_bit)
+        {
+            faultPage = entry->page_number;
+            return true;
+        }
+        table->tlb.insert(process_id, segment, offset, *entry, pageBytes);
+        frame_ram = entry->frame_ram;
+        page_offset = offset - entry->offset;
+    }
+
+    std::string_view content = ramPageContent(frame_ram);
+    if (page_offset >= content.size())
+    {
+        return false;
+    }
+    value = content[page_offset];
+    faultPage = -1;
+    return true;
+}
+
+// Escribe los datos a partir de la dirección lógica del proceso y marca como sucias
+// las páginas modificadas. Las páginas conservan su tamaño: no se puede escribir
+// más allá del final del segmento.
+bool writeMemory(int process_id, int segment, size_t offset, const string &data)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    bool written_all = true;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        if (table == nullptr)
+        {
+            cerr << "Dirección lógica inválida: proceso " << process_id << ", segmento " << segment << ", desplazamiento " << offset << endl;
+            return false;
+        }
+
+        std::lock_guard<std::mutex> processLock(table->lock);
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ResolvedAddress address;
+            bool faulted = false;
+            if (!resolveAddressLocked(*table, segment, offset + written, address, faulted))
+            {
+                written_all = false;
+                break;
+            }
+            // La primera escritura en una página limpia la deja con frames propios
+            PageTableEntry *entry = findPage(*table, segment, address.page_number);
+            if (!entry->dirty_bit && !makePagePrivateLocked(*table, segment, *entry, true))
+            {
+                written_all = false;
+                break;
+            }
+            size_t chunk = std::min(data.size() - written, ramPageContent(entry->frame_ram).size() - address.page_offset);
+            writeRamPageBytes(entry->frame_ram, address.page_offset, std::string_view(data).substr(written, chunk));
+            if (!entry->dirty_bit)
+            {
+                entry->dirty_bit = true;
+                pageEntryChanged(*table, *findSegment(*table, segment), *entry);
+            }
+            written += chunk;
+        }
+        ramImageModified = true;
+    }
+
+    persistIfWriteThrough();
+    return written_all;
+}
+
+// Suma delta al contador de fijación de una página, en su entrada de la tabla de páginas
+// y en el frame de RAM que la contiene. Si se fija una página ausente primero se carga.
+bool adjustPinCount(int process_id, int segment, int page, int delta)
+{
+    SharedImageTransaction transaction({process_id});
+    if (!ensureMemoryImage())
+    {
+        return false;
+    }
+
+    bool adjusted = false;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(process_id);
+        PageTableEntry *entry = nullptr;
+        if (table != nullptr)
+        {
+            std::lock_guard<std::mutex> processLock(table->lock);
+            if (delta > 0 && !swapInLocked(*table, segment, page))
+            {
+                return false;
+            }
+            entry = findPage(*table, segment, page);
+            // Una página fijada no se comparte
+            if (entry != nullptr && delta > 0 && entry->presence_bit && !makePagePrivateLocked(*table, segment, *entry, false))
+            {
+                return false;
+            }
+            if (entry != nullptr && entry->presence_bit && entry->pin_count + delta >= 0)
+            {
+                entry->pin_count += delta;
+                setRamFramePinCount(entry->frame_ram, entry->pin_count);
+                pageEntryChanged(*table, *findSegment(*table, segment), *entry);
+                ramImageModified = true;
+                adjusted = true;
+            }
+        }
+    }
+
+    if (!adjusted)
+    {
+        cerr << "La página " << page << " del segmento " << segment << " no se puede fijar/liberar" << endl;
+        return false;
+    }
+    persistIfWriteThrough();
+    return true;
+}
+
+// Fija una página en RAM (como mlock): se carga si hace falta y deja de ser candidata a desalojo
+bool pinPage(int process_id, int segment, int page)
+{
+    return adjustPinCount(process_id, segment, page, 1);
+}
+
+// Deshace un pinPage; la página vuelve a poder desalojarse cuando el contador llega a 0
+bool unpinPage(int process_id, int segment, int page)
+{
+    return adjustPinCount(process_id, segment, page, -1);
+}
+
+// Servicio asíncrono de fallos de página. Los llamadores encolan el fallo y reciben un
+// future (o registran un callback); un grupo de hilos los atiende con memorySwap. Como
+// cada fallo solo bloquea a su proceso, la lectura de Swap de un fallo se solapa con la
+// elección de víctimas de fallos de otros procesos. Los fallos repetidos sobre una página
+// que ya está en cola se unen al pendiente en vez de encolarse otra vez.
+class FaultService
+{
+public:
+    explicit FaultService(size_t workers = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (size_t i = 0; i < workers; ++i)
+        {
+            threads.emplace_back([this]
+                                 { workerLoop(); });
+        }
+    }
+
+    ~FaultService()
+    {
+        {
+            std::lock_guard<std::mutex> queueLock(queueMutex);
+            stopping = true;
+        }
+        queueReady.notify_all();
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    FaultService(const FaultService &) = delete;
+    FaultService &operator=(const FaultService &) = delete;
+
+    // Encola el fallo de la página; el future vale true cuando la página ya está en RAM
+    std::shared_future<bool> submit(int process_id, int segment, int page)
+    {
+        return enqueue(process_id, segment, page, nullptr);
+    }
+
+    // Encola el fallo y llama a callback (desde un hilo del servicio) al terminar
+    void submit(int process_id, int segment, int page, std::function<void(bool)> callback)
+    {
+        enqueue(process_id, segment, page, std::move(callback));
+    }
+
+    long long submitted() const { return submittedCount; }
+    long long coalesced() const { return coalescedCount; }
+    long long completed() const { return completedCount; }
+    long long failed() const { return failedCount; }
+
+private:
+    struct PendingFault
+    {
+        int process_id;
+        int segment;
+        int page;
+        std::promise<bool> promise;
+        std::shared_future<bool> future;
+        std::vector<std::function<void(bool)>> callbacks;
+    };
+
+    std::shared_future<bool> enqueue(int process_id, int segment, int page, std::function<void(bool)> callback)
+    {
+        std::shared_future<bool> future;
+        {
+            std::lock_guard<std::mutex> queueLock(queueMutex);
+            submittedCount++;
+            auto key = std::make_tuple(process_id, segment, page);
+            auto existing = pending.find(key);
+            if (existing != pending.end())
+            {
+                coalescedCount++;
+                if (callback)
+                {
+                    existing->second->callbacks.push_back(std::move(callback));
+                }
+                return existing->second->future;
+            }
+
+            auto fault = std::make_shared<PendingFault>();
+            fault->process_id = process_id;
+            fault->segment = segment;
+            fault->page = page;
+            fault->future = fault->promise.get_future().share();
+            if (callback)
+            {
+                fault->callbacks.push_back(std::move(callback));
+            }
+            pending[key] = fault;
+            queue.push_back(fault);
+            future = fault->future;
+        }
+        queueReady.notify_one();
+        return future;
+    }
+
+    void workerLoop()
+    {
+        while (true)
+        {
+            std::shared_ptr<PendingFault> fault;
+            {
+                std::unique_lock<std::mutex> queueLock(queueMutex);
+                if (queue.empty() && !stopping)
+                {
+                    // Antes de quedarse inactivo el hilo devuelve los frames de sus magazines
+                    queueLock.unlock();
+                    flushThreadMagazines();
+                    queueLock.lock();
+                }
+                queueReady.wait(queueLock, [this]
+                                { return stopping || !queue.empty(); });
+                if (queue.empty())
+                {
+                    return;
+                }
+                fault = queue.front();
+                queue.pop_front();
+            }
+
+            bool loaded = memorySwap(fault->segment, fault->page, fault->process_id);
+
+            std::vector<std::function<void(bool)>> callbacks;
+            {
+                // Desde aquí un nuevo fallo sobre la página se encola aparte
+                std::lock_guard<std::mutex> queueLock(queueMutex);
+                pending.erase(std::make_tuple(fault->process_id, fault->segment, fault->page));
+                callbacks.swap(fault->callbacks);
+            }
+            loaded ? completedCount++ : failedCount++;
+            fault->promise.set_value(loaded);
+            for (auto &callback : callbacks)
+            {
+                callback(loaded);
+            }
+        }
+    }
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::shared_ptr<PendingFault>> queue;
+    std::map<std::tuple<int, int, int>, std::shared_ptr<PendingFault>> pending;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+    std::atomic<long long> submittedCount{0};
+    std::atomic<long long> coalescedCount{0};
+    std::atomic<long long> completedCount{0};
+    std::atomic<long long> failedCount{0};
+};
+
+// Servicio de fallos compartido, se crea la primera vez que se usa
+FaultService &faultService()
+{
+    static FaultService service;
+    return service;
+}
+
+// Versión asíncrona de memorySwap
+std::shared_future<bool> memorySwapAsync(int segment, int page, int process_id)
+{
+    return faultService().submit(process_id, segment, page);
+}
+
+#if defined(__cpp_impl_coroutine)
+class CoroutineExecutor;
+
+// Tarea con corrutina que devuelve un T. Empieza suspendida y corre cuando otra tarea
+// la espera con co_await (o la lanza CoroutineExecutor::spawn); al terminar reanuda a
+// quien la esperaba.
+template <typename T>
+class MemoryTask
+{
+public:
+    struct promise_type
+    {
+        T value{};
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+
+        MemoryTask get_return_object()
+        {
+            return MemoryTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter
+        {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+                auto continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_value(T result) { value = std::move(result); }
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    MemoryTask(MemoryTask &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    MemoryTask(const MemoryTask &) = delete;
+    MemoryTask &operator=(const MemoryTask &) = delete;
+    ~MemoryTask()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+    {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume()
+    {
+        if (handle.promise().error)
+        {
+            std::rethrow_exception(handle.promise().error);
+        }
+        return std::move(handle.promise().value);
+    }
+
+private:
+    explicit MemoryTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Corrutina sin dueño que se destruye sola al terminar (la usa spawn)
+struct DetachedTask
+{
+    struct promise_type
+    {
+        DetachedTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+// Ejecutor de un solo hilo para las tareas con corrutinas. Una tarea que provoca un fallo
+// de página se suspende, el fallo lo atiende FaultService y al terminar la tarea vuelve a
+// la cola; mientras tanto el hilo sigue con las demás. Así un solo hilo mantiene miles de
+// procesos simulados en curso.
+class CoroutineExecutor
+{
+public:
+    // Espera que suspende la tarea hasta que la página está en RAM; devuelve si se pudo cargar
+    struct PageFaultAwaiter
+    {
+        CoroutineExecutor &executor;
+        int process_id;
+        int segment;
+        int page;
+        bool loaded = false;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle)
+        {
+            faultService().submit(process_id, segment, page, [this, handle](bool result)
+                                  {
+                loaded = result;
+                executor.schedule(handle); });
+        }
+        bool await_resume() const noexcept { return loaded; }
+    };
+
+    // Espera que devuelve la tarea al final de la cola para dejar correr a las demás
+    struct YieldAwaiter
+    {
+        CoroutineExecutor &executor;
+
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> handle) { executor.schedule(handle); }
+        void await_resume() const noexcept {}
+    };
+
+    PageFaultAwaiter pageFault(int process_id, int segment, int page)
+    {
+        return {*this, process_id, segment, page};
+    }
+
+    YieldAwaiter yield()
+    {
+        return {*this};
+    }
+
+    // Encola una tarea para reanudarla en run(). Se puede llamar desde cualquier hilo.
+    void schedule(std::coroutine_handle<> handle)
+    {
+        // Se notifica con el lock tomado: en cuanto run() ve la tarea puede terminar y
+        // destruirse el ejecutor
+        std::lock_guard<std::mutex> queueLock(queueMutex);
+        ready.push_back(handle);
+        queueReady.notify_one();
+    }
+
+    // Lanza una tarea; done recibe su resultado. Corre en el siguiente run().
+    template <typename T>
+    void spawn(MemoryTask<T> task, std::function<void(std::type_identity_t<T>)> done = nullptr)
+    {
+        {
+            std::lock_guard<std::mutex> queueLock(queueMutex);
+            liveTasks++;
+        }
+        runDetached(std::move(task), std::move(done));
+    }
+
+    // Ejecuta las tareas en este hilo hasta que terminan todas las lanzadas
+    void run()
+    {
+        std::unique_lock<std::mutex> queueLock(queueMutex);
+        while (true)
+        {
+            queueReady.wait(queueLock, [this]
+                            { return !ready.empty() || liveTasks == 0; });
+            if (ready.empty())
+            {
+                return;
+            }
+            std::coroutine_handle<> handle = ready.front();
+            ready.pop_front();
+            queueLock.unlock();
+            handle.resume();
+            queueLock.lock();
+        }
+    }
+
+    long long failedTasks() const { return failedCount; }
+
+private:
+    template <typename T>
+    DetachedTask runDetached(MemoryTask<T> task, std::function<void(T)> done)
+    {
+        co_await yield();
+        try
+        {
+            T result = co_await task;
+            if (done)
+            {
+                done(std::move(result));
+            }
+        }
+        catch (const std::exception &error)
+        {
+            failedCount++;
+            cerr << "Tarea terminada con error: " << error.what() << endl;
+        }
+
+        std::lock_guard<std::mutex> queueLock(queueMutex);
+        liveTasks--;
+        // run() comprueba liveTasks con el lock tomado, no hace falta notificar
+    }
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<std::coroutine_handle<>> ready;
+    size_t liveTasks = 0;
+    long long failedCount = 0;
+};
+
+// Variante de accessMemory que se suspende mientras se atiende el fallo de página.
+// Lanza std::out_of_range si la dirección no es válida.
+MemoryTask<char> accessMemoryTask(CoroutineExecutor &executor, int process_id, int segment, size_t offset)
+{
+    while (true)
+    {
+        char value;
+        int faultPage;
+        if (!tryAccessMemory(process_id, segment, offset, value, faultPage))
+        {
+            throw std::out_of_range("Dirección lógica inválida");
+        }
+        if (faultPage == -1)
+        {
+            co_return value;
+        }
+        // Otra tarea puede desalojar la página antes de leerla: se vuelve a intentar
+        if (!co_await executor.pageFault(process_id, segment, faultPage))
+        {
+            throw std::runtime_error("Memoria RAM Insuficiente");
+        }
+    }
+}
+
+// Variante de memorySwap que se suspende hasta que la página está en RAM
+MemoryTask<bool> memorySwapTask(CoroutineExecutor &executor, int segment, int page, int process_id)
+{
+    co_return co_await executor.pageFault(process_id, segment, page);
+}
+
+// Variante de memoryAllocation: segmenta el programa y cede el turno antes de asignarle
+// frames, así la lectura de muchos programas se intercala con el resto de tareas
+MemoryTask<bool> memoryAllocationTask(CoroutineExecutor &executor, int process_id)
+{
+    MappedProgram program;
+    vector<vector<string_view>> segment;
+    if (!segmentProgram(filePath, program, segment))
+    {
+        co_return false;
+    }
+    co_await executor.yield();
+    co_return uploadToRam(segment, process_id);
+}
+#endif
+
+// Arranca el reclamador en segundo plano
+void startReclaimer()
+{
+    reclaimer().start();
+}
+
+void stopReclaimer()
+{
+    reclaimer().stop();
+}
+
+// Activa la deduplicación de páginas. No se puede usar con la imagen compartida: esta
+// guarda el estado de cada página en su frame de Swap y no admite frames compartidos.
+bool enablePageDeduplication()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    if (sharedImage.attached())
+    {
+        cerr << "La deduplicación no se puede usar con la imagen compartida" << endl;
+        return false;
+    }
+    pageDeduplication = true;
+    return true;
+}
+
+// Desactiva la deduplicación y para el escáner. Los frames que ya se comparten siguen
+// compartidos hasta que sus páginas se escriben o se liberan.
+void disablePageDeduplication()
+{
+    deduplicationScanner().stop();
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    std::lock_guard<std::mutex> dedupLock(dedupMutex);
+    pageDeduplication = false;
+    ramContentIndex.clearContent();
+    swapContentIndex.clearContent();
+}
+
+// Activa la deduplicación y el escáner que fusiona los duplicados que ya existen
+bool startDeduplicator()
+{
+    if (!enablePageDeduplication())
+    {
+        return false;
+    }
+    deduplicationScanner().start();
+    return true;
+}
+
+void stopDeduplicator()
+{
+    deduplicationScanner().stop();
+}
+
+// Revisa todas las páginas de una vez y fusiona los duplicados. Devuelve los frames fusionados.
+size_t mergeDuplicatePages()
+{
+    SharedImageTransaction transaction;
+    if (!pageDeduplication || !ensureMemoryImage())
+    {
+        return 0;
+    }
+
+    size_t merged;
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        merged = mergeDuplicatePagesLocked(SIZE_MAX);
+        dedupStats.scans++;
+    }
+    flushThreadMagazines();
+    persistIfWriteThrough();
+    return merged;
+}
+
+// Frames compartidos y memoria que se ahorra con la deduplicación
+struct DedupReport
+{
+    size_t ram_shared_frames = 0;
+    long long ram_pages_saved = 0; // Páginas residentes que no ocupan un frame propio
+    size_t ram_bytes_saved = 0;
+    size_t swap_shared_frames = 0;
+    long long swap_pages_saved = 0;
+    size_t swap_bytes_saved = 0;
+};
+
+DedupReport deduplicationReport()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    std::lock_guard<std::mutex> dedupLock(dedupMutex);
+    DedupReport report;
+    report.ram_shared_frames = ramContentIndex.sharedFrames();
+    report.ram_pages_saved = ramContentIndex.sharedReferences();
+    report.ram_bytes_saved = ramContentIndex.bytesSaved();
+    report.swap_shared_frames = swapContentIndex.sharedFrames();
+    report.swap_pages_saved = swapContentIndex.sharedReferences();
+    report.swap_bytes_saved = swapContentIndex.bytesSaved();
+    return report;
+}
+
+// Muestra lo que se ahorra con la deduplicación y de dónde salen las fusiones
+void printDeduplicationStats()
+{
+    DedupReport report = deduplicationReport();
+    cout << "RAM | Frames compartidos: " << report.ram_shared_frames
+         << " | Páginas sin frame propio: " << report.ram_pages_saved
+         << " | Bytes ahorrados: " << report.ram_bytes_saved << endl;
+    cout << "Swap | Frames compartidos: " << report.swap_shared_frames
+         << " | Páginas sin frame propio: " << report.swap_pages_saved
+         << " | Bytes ahorrados: " << report.swap_bytes_saved << endl;
+    cout << "Fusiones al cargar: " << dedupStats.load_merges
+         << " | En fallos: " << dedupStats.fault_merges
+         << " | Del escáner: " << dedupStats.scan_merges << " (" << dedupStats.scans << " pasadas)"
+         << " | Copias al escribir: " << dedupStats.cow_copies << endl;
+    cout << "Procesos clonados: " << dedupStats.forks
+         << " | Páginas compartidas al clonar: " << dedupStats.fork_shared_pages << endl;
+}
+
+// Activa o desactiva la compresión del Swap. El contenido que ya está en Swap se
+// comprime o se descomprime al momento.
+void configureSwapCompression(bool enabled)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    if (enabled == compressedSwap)
+    {
+        return;
+    }
+    if (sharedImage.attached())
+    {
+        cerr << "El Swap comprimido no se puede usar con la imagen compartida" << endl;
+        return;
+    }
+    if (!enabled && imageLoaded)
+    {
+        for (auto &frame : swapFrames)
+        {
+            compressedSwapStore.load(frame.frame_number, frame.content); // Uno dañado queda vacío
+        }
+    }
+    compressedSwap = enabled;
+    packSwapFramesLocked();
+}
+
+// Ocupación del Swap comprimido y coste del compresor
+struct SwapCompressionReport
+{
+    size_t original_bytes = 0; // Contenido de las páginas sin comprimir
+    size_t stored_bytes = 0;   // Bytes que ocupan en el área
+    size_t arena_bytes = 0;    // Tamaño del área, con los huecos
+    size_t free_bytes = 0;     // Bytes en huecos reutilizables
+    size_t holes = 0;
+    double ratio = 1.0;        // original_bytes / stored_bytes
+    long long compressions = 0;
+    long long incompressible = 0;
+    long long decompressions = 0;
+    double compress_ns_per_page = 0;
+    double decompress_ns_per_page = 0;
+};
+
+SwapCompressionReport swapCompressionReport()
+{
+    SwapCompressionReport report;
+    compressedSwapStore.usage(report.original_bytes, report.stored_bytes, report.arena_bytes,
+                              report.free_bytes, report.holes);
+    if (report.stored_bytes > 0)
+    {
+        report.ratio = static_cast<double>(report.original_bytes) / report.stored_bytes;
+    }
+    report.compressions = swapCompressionStats.compressions;
+    report.incompressible = swapCompressionStats.incompressible;
+    report.decompressions = swapCompressionStats.decompressions;
+    if (report.compressions > 0)
+    {
+        report.compress_ns_per_page = static_cast<double>(swapCompressionStats.compress_ns) / report.compressions;
+    }
+    if (report.decompressions > 0)
+    {
+        report.decompress_ns_per_page = static_cast<double>(swapCompressionStats.decompress_ns) / report.decompressions;
+    }
+    return report;
+}
+
+// Muestra cuánto se ahorra con el Swap comprimido y cuánto cuesta
+void printSwapCompressionStats()
+{
+    SwapCompressionReport report = swapCompressionReport();
+    cout << "Swap comprimido | Bytes originales: " << report.original_bytes
+         << " | Guardados: " << report.stored_bytes
+         << " | Relación: " << report.ratio << endl;
+    cout << "Área: " << report.arena_bytes << " bytes | En huecos: " << report.free_bytes
+         << " (" << report.holes << " huecos)" << endl;
+    cout << "Compresiones: " << report.compressions << " (" << report.incompressible << " sin reducir)"
+         << " | " << report.compress_ns_per_page << " ns/página"
+         << " | Descompresiones: " << report.decompressions
+         << " | " << report.decompress_ns_per_page << " ns/página" << endl;
+}
+
+// Cambia el límite en bytes comprimidos de la caché comprimida entre RAM y Swap. Con 0
+// se apaga: las entradas sucias se escriben en Swap y las demás se descartan.
+void configureCompressedCache(size_t maxBytes)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    if (sharedImage.attached() && maxBytes > 0)
+    {
+        cerr << "La caché comprimida no se puede usar con la imagen compartida" << endl;
+        return;
+    }
+    compressedPageCache.configure(maxBytes);
+}
+
+// Ocupación y eficacia de la caché comprimida
+struct PageCacheReport
+{
+    size_t entries = 0;
+    size_t dirty_entries = 0; // Páginas más recientes que su frame de Swap
+    size_t original_bytes = 0;
+    size_t stored_bytes = 0;
+    size_t capacity = 0;
+    double hit_rate = 0; // Fallos atendidos desde la caché sobre los fallos con la caché activa
+    long long hits = 0;
+    long long misses = 0;
+    long long stores = 0;
+    long long incompressible = 0;
+    long long writebacks = 0;
+    long long discards = 0;
+    long long corrupted = 0;
+    double compress_ns_per_page = 0;
+    double decompress_ns_per_hit = 0;
+};
+
+PageCacheReport compressedCacheReport()
+{
+    PageCacheReport report;
+    compressedPageCache.usage(report.entries, report.dirty_entries, report.original_bytes,
+                              report.stored_bytes, report.capacity);
+    report.hits = pageCacheStats.hits;
+    report.misses = pageCacheStats.misses;
+    report.stores = pageCacheStats.stores;
+    report.incompressible = pageCacheStats.incompressible;
+    report.writebacks = pageCacheStats.writebacks;
+    report.discards = pageCacheStats.discards;
+    report.corrupted = pageCacheStats.corrupted;
+    if (report.hits + report.misses > 0)
+    {
+        report.hit_rate = static_cast<double>(report.hits) / (report.hits + report.misses);
+    }
+    if (report.stores > 0)
+    {
+        report.compress_ns_per_page = static_cast<double>(pageCacheStats.compress_ns) / report.stores;
+    }
+    if (report.hits > 0)
+    {
+        report.decompress_ns_per_hit = static_cast<double>(pageCacheStats.decompress_ns) / report.hits;
+    }
+    return report;
+}
+
+// Muestra la ocupación de la caché comprimida y cuántos fallos se atienden desde ella
+void printCompressedCacheStats()
+{
+    PageCacheReport report = compressedCacheReport();
+    cout << "Caché comprimida | Entradas: " << report.entries << " (" << report.dirty_entries << " sucias)"
+         << " | Bytes: " << report.stored_bytes << " de " << report.capacity
+         << " (" << report.original_bytes << " sin comprimir)" << endl;
+    cout << "Aciertos: " << report.hits << " | Fallos: " << report.misses
+         << " | Tasa de aciertos: " << report.hit_rate * 100 << "%"
+         << " | " << report.decompress_ns_per_hit << " ns/acierto" << endl;
+    cout << "Guardadas: " << report.stores << " (" << report.incompressible << " sin reducir)"
+         << " | Escritas en Swap: " << report.writebacks << " | Descartadas: " << report.discards
+         << " | Dañadas: " << report.corrupted
+         << " | " << report.compress_ns_per_page << " ns/página" << endl;
+}
+
+// Cambia la política de páginas grandes para los segmentos que se carguen a partir de
+// ahora: los de al menos minSegmentBytes usan páginas de frames frames (1 = desactivadas)
+void configureHugePages(int frames, size_t minSegmentBytes)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    hugePageFrames = std::clamp(frames, 1, maxHugePageFrames);
+    hugePageMinBytes = minSegmentBytes;
+}
+
+// Cambia las marcas de frames libres del reclamador (porcentajes de los frames de RAM)
+void configureReclaimer(int lowPercent, int highPercent)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    reclaimLowPercent = lowPercent;
+    reclaimHighPercent = std::max(lowPercent, highPercent);
+}
+
+// Cambia la geometría de la TLB de todos los procesos (vacía sus entradas)
+void configureTLB(size_t sets, size_t ways)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    tlbSets = sets;
+    tlbWays = ways;
+    for (auto &process : pageTables)
+    {
+        auto &tlb = process.second->tlb;
+        retiredTLBStats.hits += tlb.hits();
+        retiredTLBStats.misses += tlb.misses();
+        retiredTLBStats.invalidations += tlb.invalidations();
+        tlb.configure(sets, ways);
+    }
+}
+
+// Cambia el número de shards de las tablas de RAM y Swap y reparte de nuevo los frames libres
+void configureFrameShards(size_t shards)
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    frameShards = shards;
+    if (imageLoaded)
+    {
+        resetFramePoolsLocked();
+    }
+}
+
+// Muestra los frames libres y los robos de cada shard
+void printFrameShards()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    for (auto pool : {&ramPool, &swapPool})
+    {
+        cout << (pool == &ramPool ? "RAM" : "Swap") << endl;
+        for (const auto &shard : pool->getShards())
+        {
+            cout << "  Frames " << shard->first_frame << "-" << shard->first_frame + shard->frame_count - 1
+                 << " | Libres: " << shard->magazines.available()
+                 << " | Robados por otros procesos: " << shard->steals << endl;
+        }
+    }
+}
+
+// Suma las estadísticas de las TLB de todos los procesos, vivos y liberados
+TLBStats tlbStats()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    TLBStats stats = retiredTLBStats;
+    for (const auto &process : pageTables)
+    {
+        const auto &tlb = process.second->tlb;
+        stats.hits += tlb.hits();
+        stats.misses += tlb.misses();
+        stats.invalidations += tlb.invalidations();
+    }
+    return stats;
+}
+
+// Resultado de una pasada de runFrameAllocator
+struct FrameAllocatorRun
+{
+    long long doubleClaims = 0; // Frames que un hilo recibió mientras otro los tenía
+    size_t freeAtEnd = 0;       // Frames libres en el bitmap cuando terminaron los hilos
+    double seconds = 0;
+};
+
+// Reparte operations reservas y liberaciones por hilo sobre un bitmap con los frames de
+// pool, con o sin magazines por hilo. Con verify se anota el dueño de cada frame para
+// detectar reservas dobles (y la medida de tiempo deja de ser solo del asignador).
+FrameAllocatorRun runFrameAllocator(const std::vector<Frame> &pool, int threads, bool useMagazines, int operations, bool verify)
+{
+    size_t frames = pool.size();
+    AtomicFrameBitmap bitmap;
+    bitmap.reset(pool);
+    FrameAllocatorRun run;
+    {
+        MagazinePool magazines(bitmap);
+        std::unique_ptr<std::atomic<int>[]> owner(new std::atomic<int>[frames]);
+        for (size_t i = 0; i < frames; ++i)
+        {
+            owner[i] = -1;
+        }
+        std::atomic<long long> doubleClaims{0};
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+                                 {
+                size_t hint = static_cast<size_t>(t) * 8;
+                int held[8];
+                size_t count = 0;
+                for (int i = 0; i < operations; ++i)
+                {
+                    int frame_number = useMagazines ? magazines.allocate() : bitmap.claim(hint);
+                    if (frame_number != -1)
+                    {
+                        if (verify && owner[frame_number].exchange(t) != -1)
+                        {
+                            doubleClaims++;
+                        }
+                        held[count++ % 8] = frame_number;
+                    }
+                    // Mantener unos pocos frames reservados para mezclar reservas y liberaciones
+                    if (count >= 8 || (frame_number == -1 && count > 0))
+                    {
+                        int released = held[--count % 8];
+                        if (verify)
+                        {
+                            owner[released] = -1;
+                        }
+                        useMagazines ? magazines.release(released) : bitmap.release(released);
+                    }
+                }
+                while (count > 0)
+                {
+                    int released = held[--count % 8];
+                    owner[released] = -1;
+                    useMagazines ? magazines.release(released) : bitmap.release(released);
+                } });
+        }
+        // Cada hilo vacía su magazine en el bitmap al terminar
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+
+        run.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        run.doubleClaims = doubleClaims;
+    }
+    run.freeAtEnd = bitmap.freeCount();
+    return run;
+}
+
+// Estrés y rendimiento de los asignadores de frames (el bitmap solo y con magazines por
+// hilo). La pasada de estrés cuenta las reservas dobles; la de rendimiento mide solo
+// reservas y liberaciones. Se ejecuta con MemoryManager --benchmark.
+void benchmarkFrameAllocator(size_t frames = 1 << 16, int operations = 200000)
+{
+    std::vector<Frame> pool(frames);
+    for (size_t i = 0; i < frames; ++i)
+    {
+        pool[i] = {"", static_cast<int>(i), true, 0, 0, 0, 0};
+    }
+
+    for (int threads : {1, 4, 16, 64})
+    {
+        for (bool useMagazines : {false, true})
+        {
+            FrameAllocatorRun verified = runFrameAllocator(pool, threads, useMagazines, operations, true);
+            FrameAllocatorRun timed = runFrameAllocator(pool, threads, useMagazines, operations, false);
+
+            cout << (useMagazines ? "Magazines" : "Bitmap   ")
+                 << " | Hilos: " << threads
+                 << " | Reservas por segundo: " << static_cast<long long>(threads * operations / timed.seconds)
+                 << " | ns por reserva+liberación: " << timed.seconds * 1e9 / (static_cast<double>(threads) * operations)
+                 << " | Errores: " << verified.doubleClaims
+                 << " | Frames libres al final: " << verified.freeAtEnd << "/" << frames << endl;
+        }
+    }
+}
+
+// Pruebas del gestor. Cada una trabaja sobre una imagen propia (ver TestImage) y
+// devuelve false si falla alguna comprobación; runSelfTests las ejecuta todas.
+
+// Imagen de prueba en un directorio temporal: RAM.json y Swap.json con frames libres y un
+// programa con el texto dado. Mientras existe, las rutas globales apuntan a ella y la
+// imagen en memoria es la suya; al destruirse se borra y se restauran las rutas.
+class TestImage
+{
+public:
+    TestImage(size_t ramCount, size_t swapCount, const std::string &program)
+        : savedRAMPath(jsonRAMPath), savedSwapPath(jsonSwapPath), savedFilePath(filePath)
+    {
+        char pattern[] = "/tmp/memorymanagerXXXXXX";
+        if (mkdtemp(pattern) == nullptr)
+        {
+            throw std::runtime_error("No se pudo crear el directorio de pruebas");
+        }
+        directory = pattern;
 
-    // Método para calcular la memoria disponible
-    int calculateAvailableMemory()
+        for (auto [path, count] : {std::pair<std::string, size_t>{directory + "/RAM.json", ramCount}, {directory + "/Swap.json", swapCount}})
+        {
+            std::vector<Frame> frames(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                frames[i] = {"", static_cast<int>(i), true, 0, 0, 0, 0};
+            }
+            json image;
+            image["frames"] = framesToJson(frames, true);
+            std::ofstream(path) << image.dump();
+        }
+        std::ofstream(directory + "/programa.txt") << program;
+
+        jsonRAMPath = directory + "/RAM.json";
+        jsonSwapPath = directory + "/Swap.json";
+        filePath = directory + "/programa.txt";
+        loadMemoryImage();
+    }
+
+    ~TestImage()
+    {
+        jsonRAMPath = savedRAMPath;
+        jsonSwapPath = savedSwapPath;
+        filePath = savedFilePath;
+        {
+            std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+            imageLoaded = false; // La siguiente operación vuelve a cargar los JSON de verdad
+        }
+        for (const char *name : {"/RAM.json", "/Swap.json", "/programa.txt"})
+        {
+            std::remove((directory + name).c_str());
+        }
+        rmdir(directory.c_str());
+    }
+
+    TestImage(const TestImage &) = delete;
+    TestImage &operator=(const TestImage &) = delete;
+
+private:
+    std::string directory;
+    std::string savedRAMPath;
+    std::string savedSwapPath;
+    std::string savedFilePath;
+};
+
+// Texto de prueba con el número de líneas indicado
+std::string testProgram(int lines)
+{
+    std::string text;
+    for (int i = 0; i < lines; ++i)
+    {
+        text += "    int variable" + std::to_string(i % 13) + " = calcular(valor" + std::to_string(i % 5) + ", " + std::to_string(i) + ");\n";
+    }
+    return text;
+}
+
+bool check(bool condition, const std::string &description)
+{
+    if (!condition)
+    {
+        std::cerr << "FALLO: " << description << std::endl;
+    }
+    return condition;
+}
+
+// Las páginas presentes de todos los procesos y los frames libres de RAM suman la RAM
+// entera. Un frame compartido (deduplicado o heredado con forkProcess) se cuenta una vez.
+bool ramFramesAccounted()
+{
+    ramPool.flushLocal();
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    std::set<int> resident;
+    size_t residentFrames = 0;
+    for (const auto &process : pageTables)
+    {
+        for (const auto &segmentTable : process.second->segments)
+        {
+            for (const auto &entry : segmentTable.pages)
+            {
+                if (!entry.presence_bit)
+                {
+                    continue;
+                }
+                if (entry.frame_ram < 0 || entry.frame_ram >= static_cast<int>(ramFrames.size()) || ramFrames[entry.frame_ram].is_free)
+                {
+                    return false;
+                }
+                if (resident.insert(entry.frame_ram).second)
+                {
+                    residentFrames += segmentTable.page_size / static_cast<size_t>(pageSize);
+                }
+            }
+        }
+    }
+    return residentFrames + ramPool.available() == ramFrames.size();
+}
+
+// (proceso, segmento, página) de todas las páginas presentes en RAM
+std::set<std::tuple<int, int, int>> residentPages()
+{
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    std::set<std::tuple<int, int, int>> pages;
+    for (const auto &process : pageTables)
     {
-        int free_frames = 0;
-        for (const auto &frame : frames)
+        for (const auto &segmentTable : process.second->segments)
         {
-            if (frame.is_free)
+            for (const auto &entry : segmentTable.pages)
             {
-                free_frames++;
+                if (entry.presence_bit)
+                {
+                    pages.insert({process.first, segmentTable.segment_id, entry.page_number});
+                }
             }
         }
-        return free_frames * FRAME_SIZE;
     }
+    return pages;
+}
 
-    // Método para calcular la memoria consumida por un proceso específico
-    int calculateMemoryUsedByProcess(int process_id)
+// Todas las páginas de los procesos indicados, como peticiones de un lote
+vector<PageRequest> allPages(std::initializer_list<int> process_ids)
+{
+    std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+    vector<PageRequest> requests;
+    for (int process_id : process_ids)
     {
-        int used_frames = 0;
-        for (const auto &frame : frames)
+        for (const auto &segmentTable : findProcess(process_id)->segments)
         {
-            if (frame.process_id == process_id && !frame.is_free)
+            for (const auto &entry : segmentTable.pages)
             {
-                used_frames++;
+                requests.push_back({process_id, segmentTable.segment_id, entry.page_number});
             }
         }
-        return used_frames * FRAME_SIZE;
     }
+    return requests;
+}
 
-private:
-    std::vector<Frame> frames;
-    static const int FRAME_SIZE = 4 * 1024;
-};
+// memorySwapBatch con más páginas de las que caben en RAM: devuelve false sin cargar ni
+// desalojar nada
+bool testSwapBatchWithoutFrames()
+{
+    TestImage image(64, 4096, testProgram(300));
+    bool ok = check(memoryAllocation(1) && memoryAllocation(2), "cargar los procesos de la prueba");
 
-std::vector<Frame> loadFramesFromJson(const std::string &filename)
+    vector<PageRequest> requests = allPages({1, 2});
+    auto before = residentPages();
+    ok &= check(requests.size() > 64, "pedir más páginas que frames de RAM");
+    ok &= check(!memorySwapBatch(requests), "memorySwapBatch sin frames suficientes devuelve false");
+    ok &= check(residentPages() == before, "el lote fallido no carga ni desaloja páginas");
+    ok &= check(ramFramesAccounted(), "los frames de RAM siguen cuadrando tras el lote fallido");
+    return ok;
+}
+
+// Una página que no existe hace fallar el lote entero, como en memorySwap
+bool testSwapBatchMissingPage()
 {
-    std::ifstream file(filename);
-    if (!file.is_open())
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+
+    auto before = residentPages();
+    ok &= check(!memorySwapBatch({{1, 1, 2}, {1, 1, 100000}}), "una página inexistente hace fallar el lote");
+    ok &= check(!memorySwapBatch({{1, 1, 2}, {1, 99, 1}}), "un segmento inexistente hace fallar el lote");
+    ok &= check(!memorySwapBatch({{1, 1, 2}, {7, 1, 1}}), "un proceso inexistente hace fallar el lote");
+    ok &= check(residentPages() == before, "los lotes fallidos no cambian las páginas presentes");
+    ok &= check(memorySwapBatch({{1, 1, 2}, {1, 1, 3}}), "un lote válido se carga");
+    ok &= check(residentPages().count({1, 1, 3}) == 1, "la página pedida queda en RAM");
+    return ok;
+}
+
+// Las páginas de un hijo de forkProcess comparten frames de Swap con el padre; el frame de
+// RAM que les da el lote tiene que quedar a nombre del hijo
+bool testSwapBatchFrameOwner()
+{
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1) && forkProcess(1, 2), "cargar el proceso y su hijo");
+    ok &= check(memorySwapBatch({{2, 1, 2}, {2, 1, 3}}), "cargar páginas del hijo");
+
+    std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+    for (int page : {2, 3})
     {
-        throw std::runtime_error("No se pudo abrir el archivo JSON");
+        const PageTableEntry *entry = findPage(*findProcess(2), 1, page);
+        const Frame &frame = ramFrames[entry->frame_ram];
+        ok &= check(entry->presence_bit && frame.process_id == 2 && frame.segment_id == 1 && frame.page_number == page,
+                    "el frame de RAM de la página " + std::to_string(page) + " es del hijo");
     }
+    return ok;
+}
 
-    json j;
-    file >> j;
+// Una vuelta del reloj solo quita la referencia a las páginas usadas; la siguiente desaloja
+// las que no se han vuelto a usar entre tanto y respeta la que sí
+bool testReclaimSecondChance()
+{
+    TestImage image(64, 4096, testProgram(120));
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+    auto reclaimPass = []()
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        return reclaimPagesLocked(ramFrames.size(), nullptr);
+    };
 
-    std::vector<Frame> frames;
-    for (const auto &item : j["frames"])
+    // La primera página de cada segmento está en RAM desde la carga
+    for (int segment : {1, 2, 3})
     {
-        frames.push_back({item["content"].get<std::string>(),
-                          item["frame_number"].get<int>(),
-                          item["is_free"].get<bool>(),
-                          item["page_number"].get<int>(),
-                          item["process_id"].get<int>(),
-                          item["segment_id"].get<int>()});
+        accessMemory(1, segment, 0);
     }
+    reclaimPass();
+    auto before = residentPages();
+    ok &= check(before.count({1, 1, 1}) && before.count({1, 2, 1}) && before.count({1, 3, 1}),
+                "la primera vuelta no desaloja páginas usadas");
 
-    return frames;
+    accessMemory(1, 2, 0); // Se vuelve a usar entre las dos vueltas
+    reclaimPass();
+    auto after = residentPages();
+    ok &= check(after.count({1, 2, 1}) == 1, "la página usada entre vueltas sigue en RAM");
+    ok &= check(after.count({1, 1, 1}) == 0 && after.count({1, 3, 1}) == 0, "las páginas no usadas se desalojan en la segunda vuelta");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran");
+    return ok;
 }
 
-// Método para calcular la memoria libre de todo el sistema
-int freeMem()
+// Cada lista de desalojables tiene exactamente las páginas residentes y no fijadas de su segmento
+bool evictableListsConsistent()
 {
-    vector<Frame> frames = loadFramesFromJson(jsonRAMPath);
-    MemoryCalculator memoryCalculator(frames);
-    int available_memory = memoryCalculator.calculateAvailableMemory();
-    return available_memory;
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    for (auto &process : pageTables)
+    {
+        for (auto &segmentTable : process.second->segments)
+        {
+            size_t expected = 0;
+            for (const auto &entry : segmentTable.pages)
+            {
+                expected += entry.presence_bit && entry.pin_count == 0 ? 1 : 0;
+            }
+            size_t listed = 0;
+            bool valid = true;
+            forEachEvictable(segmentTable, [&](PageTableEntry &entry)
+                             {
+                valid = valid && entry.presence_bit && entry.pin_count == 0 && ++listed <= expected;
+                return valid; });
+            if (!valid || listed != expected)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Las páginas fijadas no salen de RAM con ninguna política de desalojo y las listas de
+// desalojables siguen al día con cada carga, desalojo, fijación y liberación
+bool testPinnedPagesSkipped()
+{
+    TestImage image(48, 4096, testProgram(200));
+    bool ok = check(memoryAllocation(1) && memoryAllocation(2), "cargar los procesos de la prueba");
+    ok &= check(pinPage(1, 1, 2) && pinPage(1, 1, 4) && pinPage(2, 2, 3), "fijar páginas");
+    ok &= check(evictableListsConsistent(), "listas de desalojables tras fijar");
+
+    memorySwap(1, 5, 1); // Desaloja el resto del segmento
+    memorySwapBatch({{1, 1, 6}, {1, 1, 7}, {2, 2, 5}});
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        reclaimPagesLocked(ramFrames.size(), nullptr);
+        reclaimPagesLocked(ramFrames.size(), nullptr); // Segunda vuelta del reloj
+    }
+    auto resident = residentPages();
+    ok &= check(resident.count({1, 1, 2}) && resident.count({1, 1, 4}) && resident.count({2, 2, 3}), "las páginas fijadas siguen en RAM");
+    ok &= check(resident.size() == 3, "el reclamo desaloja todas las páginas no fijadas");
+    ok &= check(evictableListsConsistent(), "listas de desalojables tras desalojar");
+
+    ok &= check(unpinPage(1, 1, 4) && memorySwap(1, 8, 1), "liberar una página y cargar otra");
+    ok &= check(residentPages().count({1, 1, 4}) == 0, "la página liberada vuelve a poder desalojarse");
+    ok &= check(evictableListsConsistent(), "listas de desalojables tras liberar");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran");
+    return ok;
 }
 
-// Función para dividir una cadena en páginas de un tamaño específico
-vector<string> pagination(const string &text, int size)
+// Los contadores de las consultas coinciden con lo que se obtiene recorriendo los frames
+bool countersMatchFrames(std::initializer_list<int> process_ids)
 {
-    vector<string> pages;
-    for (size_t i = 0; i < text.size(); i += size)
+    ramPool.flushLocal();
+    std::unique_lock<std::shared_mutex> imageLock(imageMutex);
+    int free_frames = 0;
+    int pinned_frames = 0;
+    std::map<int, int> used;
+    for (const auto &frame : ramFrames)
     {
-        pages.push_back(text.substr(i, size));
+        if (frame.is_free)
+        {
+            free_frames++;
+            continue;
+        }
+        used[frame.process_id]++;
+        if (frame.pin_count > 0)
+        {
+            pinned_frames += std::max(frame.span, 1);
+        }
     }
-    return pages;
+    bool ok = freeMem() == free_frames * pageSize && pinnedMem() == pinned_frames * pageSize;
+    for (int process_id : process_ids)
+    {
+        ok = ok && usedMem(process_id) == used[process_id] * pageSize;
+    }
+    return ok;
 }
 
-// Función usada para contar el numero de lineas de un archivo
-int countLines(const string &filePath)
+// Deduplicación con un texto de líneas iguales (cada línea llena una página): la carga y
+// los fallos comparten frames, el escáner fusiona los que se cargaron sin ella, escribir
+// copia la página y el frame compartido pasa a otro proceso cuando su dueño se libera
+bool testPageDeduplication()
 {
-    ifstream archivo(filePath);
-    if (!archivo.is_open())
+    std::string program;
+    for (int i = 0; i < 40; ++i)
     {
-        cerr << "No se pudo abrir el archivo: " << filePath << endl;
-        return -1; // Devuelve -1 si no se puede abrir el archivo
+        program += std::string(pageSize - 1, 'x') + "\n";
     }
+    TestImage image(64, 4096, program);
+    bool ok = check(enablePageDeduplication(), "activar la deduplicación");
+
+    long long loadMerges = dedupStats.load_merges;
+    ok &= check(memoryAllocation(1) && memoryAllocation(2), "cargar dos procesos con el mismo texto");
+    ok &= check(dedupStats.load_merges > loadMerges, "la carga comparte las páginas iguales");
+    long long faultMerges = dedupStats.fault_merges;
+    ok &= check(accessMemory(2, 1, pageSize) == 'x' && dedupStats.fault_merges > faultMerges,
+                "el fallo comparte el frame que ya está en RAM");
 
-    int line_counter = 0;
-    string linea;
+    releaseMemory(1);
+    ok &= check(usedMem(1) == 0 && usedMem(2) > 0, "los frames compartidos pasan al proceso que queda");
+    ok &= check(countersMatchFrames({1, 2}) && ramFramesAccounted(), "los contadores cuadran tras liberar al dueño");
+    ok &= check(accessMemory(2, 1, 0) == 'x', "el proceso que queda conserva el contenido");
 
-    while (getline(archivo, linea))
+    long long cowCopies = dedupStats.cow_copies;
+    ok &= check(writeMemory(2, 1, 0, "y") && dedupStats.cow_copies > cowCopies, "escribir una página compartida la copia");
+    ok &= check(accessMemory(2, 1, 0) == 'y' && accessMemory(2, 1, pageSize) == 'x', "la copia no cambia las otras páginas");
+    releaseMemory(2);
+    ok &= check(ramFramesAccounted(), "liberar el último proceso devuelve los frames compartidos");
+
+    disablePageDeduplication();
+    ok &= check(memoryAllocation(3) && pinPage(3, 1, 1), "cargar un proceso sin deduplicación y fijar una página");
+    for (size_t offset = 0; offset < 4 * static_cast<size_t>(pageSize); offset += pageSize)
     {
-        line_counter++;
+        accessMemory(3, 1, offset);
     }
-
-    archivo.close();
-    return line_counter;
+    enablePageDeduplication();
+    ok &= check(mergeDuplicatePages() > 0, "el escáner fusiona los frames iguales");
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        const PageTableEntry *pinned = findPage(*findProcess(3), 1, 1);
+        std::lock_guard<std::mutex> dedupLock(dedupMutex);
+        ok &= check(pinned->presence_bit && ramContentIndex.sharers(pinned->frame_ram) == 0, "la página fijada conserva su frame");
+    }
+    ok &= check(accessMemory(3, 1, 2 * pageSize) == 'x', "las páginas fusionadas conservan el contenido");
+    ok &= check(countersMatchFrames({3}) && ramFramesAccounted(), "los contadores cuadran tras el escáner");
+    disablePageDeduplication();
+    return ok;
 }
 
-// Función usada para liberar la memoria de un proceso
-void releaseMemory(int process_id)
+// lzCompress y lzDecompress: ida y vuelta con entradas vacías, sin repeticiones y muy
+// repetidas; un bloque cortado o un tamaño original distinto se rechazan
+bool testLzRoundTrip()
 {
-    std::ifstream ramJsonFile(jsonRAMPath);
-    std::ifstream swapJsonFile(jsonSwapPath);
-
-    json jsonRAM;
-    json jsonSwap;
-
-    // Manejo del JSON principal
-    if (ramJsonFile.is_open())
+    std::string noise(4096, '\0');
+    uint32_t state = 12345;
+    for (char &byte : noise)
     {
-        ramJsonFile >> jsonRAM;
-        ramJsonFile.close();
+        state = state * 1664525u + 1013904223u;
+        byte = static_cast<char>(state >> 24);
     }
-    else
+    std::vector<std::pair<std::string, std::string>> inputs = {
+        {"vacía", ""},
+        {"sin repeticiones", noise},
+        {"bytes repetidos", std::string(5000, 'a')},
+        {"texto de programa", testProgram(80)},
+    };
+
+    bool ok = true;
+    for (const auto &input : inputs)
     {
-        std::cerr << "No se pudo abrir el archivo principal JSON: " << jsonRAMPath << std::endl;
-        return;
+        std::string packed = lzCompress(input.second);
+        std::string output = "basura";
+        ok &= check(lzDecompress(packed, input.second.size(), output) && output == input.second,
+                    "ida y vuelta con la entrada " + input.first);
     }
+    ok &= check(lzCompress(std::string(5000, 'a')).size() < 100, "los bytes repetidos se reducen");
+
+    std::string text = testProgram(80);
+    std::string packed = lzCompress(text);
+    std::string output;
+    ok &= check(!lzDecompress(std::string_view(packed).substr(0, packed.size() / 2), text.size(), output),
+                "un bloque cortado se rechaza");
+    ok &= check(!lzDecompress(packed, text.size() + 1, output) && !lzDecompress(packed, text.size() - 1, output),
+                "un tamaño original distinto se rechaza");
+    return ok;
+}
 
-    // Manejo del JSON secundario
-    if (swapJsonFile.is_open())
+// memoryAllocationBatch carga todos los procesos del lote; un lote que no se puede leer
+// o no cabe no deja nada suyo y no toca los procesos que ya estaban
+bool testAllocationBatch()
+{
+    TestImage image(256, 4096, testProgram(30));
+    bool ok = check(memoryAllocationBatch({{1, filePath}, {2, filePath}, {3, filePath}}), "cargar un lote de tres procesos");
+    for (int process_id : {1, 2, 3})
     {
-        swapJsonFile >> jsonSwap;
-        swapJsonFile.close();
+        ok &= check(usedMem(process_id) > 0, "el lote carga el proceso " + std::to_string(process_id));
     }
-    else
+    ok &= check(countersMatchFrames({1, 2, 3}) && ramFramesAccounted(), "los contadores cuadran tras el lote");
+
+    auto pagesBefore = allPages({1, 2, 3}).size();
+    auto residentBefore = residentPages();
+    size_t swapBefore = swapPool.available();
+    ok &= check(!memoryAllocationBatch({{2, filePath}, {4, filePath + ".no-existe"}}), "un lote con un programa que falta falla");
+    vector<pair<int, string>> tooMany;
+    for (int process_id = 1; process_id <= 200; ++process_id)
     {
-        std::cerr << "No se pudo abrir el archivo secundario JSON: " << jsonSwapPath << std::endl;
-        return;
+        tooMany.push_back({process_id, filePath});
     }
+    ok &= check(!memoryAllocationBatch(tooMany), "un lote que no cabe falla");
 
-    // Liberar frames en el JSON principal
-    for (auto &frame : jsonRAM["frames"])
+    ok &= check(residentPages() == residentBefore && allPages({1, 2, 3}).size() == pagesBefore,
+                "los procesos anteriores siguen como estaban");
     {
-        if (frame["process_id"] == process_id && !frame["is_free"])
-        {
-            frame["is_free"] = true;  // Indicar página libre
-            frame["segment_id"] = 0;  // Reiniciar segment_id
-            frame["page_number"] = 0; // Reiniciar page_number
-            frame["content"] = "";    // Limpiar contenido
-        }
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ok &= check(findProcess(4) == nullptr && findProcess(200) == nullptr, "los lotes fallidos no dejan procesos");
     }
+    ok &= check(swapPool.available() == swapBefore && ramFramesAccounted(), "los lotes fallidos devuelven sus frames");
+    return ok;
+}
 
-    // Borrar tablas de direcciones asociadas al proceso
-    jsonRAM["SO"].erase(
-        std::remove_if(
-            jsonRAM["SO"].begin(),
-            jsonRAM["SO"].end(),
-            [process_id](const json &item)
-            { return item["process_id"] == process_id; }),
-        jsonRAM["SO"].end());
-
-    // Liberar frames en el JSON secundario
-    for (auto &frame : jsonSwap["frames"])
+// Al repartir un bitmap ajeno en shards de palabras enteras, cada shard recibe frames y
+// entre todos cubren el bitmap sin huecos
+bool testAttachedShards()
+{
+    bool ok = true;
+    for (auto [frames, shards] : std::vector<std::pair<size_t, size_t>>{{650, 10}, {100, 8}, {64, 4}, {1, 4}, {4096, 4}})
     {
-        if (frame["process_id"] == process_id && !frame["is_free"])
+        std::vector<std::atomic<uint64_t>> words((frames + 63) / 64);
+        ShardedFramePool pool;
+        pool.attach(words.data(), frames, shards);
+        size_t next = 0;
+        for (const auto &shard : pool.getShards())
         {
-            frame["is_free"] = true;  // Actualizar is_free
-            frame["segment_id"] = 0;  // Reiniciar segment_id
-            frame["page_number"] = 0; // Reiniciar page_number
-            frame["content"] = "";    // Limpiar contenido
+            ok &= check(shard->frame_count > 0 && static_cast<size_t>(shard->first_frame) == next && next % 64 == 0,
+                        "shard vacío o desalineado con " + std::to_string(frames) + " frames y " + std::to_string(shards) + " shards");
+            next += static_cast<size_t>(shard->frame_count);
         }
+        ok &= check(next == frames && pool.getShards().size() <= shards, "los shards cubren los " + std::to_string(frames) + " frames");
     }
+    return ok;
+}
 
-    // Guardar los JSON actualizados en sus archivos correspondientes
-    std::ofstream archivoPrincipalJsonSalida(jsonRAMPath);
-    if (archivoPrincipalJsonSalida.is_open())
-    {
-        archivoPrincipalJsonSalida << jsonRAM.dump(4);
-        archivoPrincipalJsonSalida.close();
-    }
-    else
+// La TLB acierta al repetir un acceso a la misma página y deja de acertar cuando la página
+// se desaloja, el proceso se libera o se cambia su geometría
+bool testTLBHitsAndInvalidations()
+{
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+    auto accessTwice = [](size_t offset)
     {
-        std::cerr << "No se pudo guardar el archivo principal JSON: " << jsonRAMPath << std::endl;
-        return;
-    }
+        TLBStats before = tlbStats();
+        accessMemory(1, 1, offset);
+        TLBStats middle = tlbStats();
+        accessMemory(1, 1, offset + 1);
+        TLBStats after = tlbStats();
+        // Fallos del primer acceso y aciertos del segundo
+        return std::make_pair(middle.misses - before.misses, after.hits - middle.hits);
+    };
 
-    std::ofstream archivoSecundarioJsonSalida(jsonSwapPath);
-    if (archivoSecundarioJsonSalida.is_open())
-    {
-        archivoSecundarioJsonSalida << jsonSwap.dump(4);
-        archivoSecundarioJsonSalida.close();
-    }
-    else
+    auto first = accessTwice(0);
+    ok &= check(first.first == 1 && first.second == 1, "el primer acceso falla en la TLB y el segundo acierta");
+    TLBStats before = tlbStats();
+    for (int i = 0; i < 5; ++i)
     {
-        std::cerr << "No se pudo guardar el archivo secundario JSON: " << jsonSwapPath << std::endl;
-        return;
+        accessMemory(1, 1, 2);
     }
+    ok &= check(tlbStats().hits - before.hits == 5 && tlbStats().misses == before.misses, "los accesos repetidos aciertan");
 
-    std::cout << "Memoria liberada en JSON principal y secundario para process_id: " << process_id << std::endl;
+    // Sin reclamador, el fallo de otra página del segmento desaloja la primera
+    before = tlbStats();
+    accessMemory(1, 1, pageSize);
+    ok &= check(tlbStats().invalidations > before.invalidations && residentPages().count({1, 1, 1}) == 0,
+                "desalojar la página invalida su entrada");
+    ok &= check(accessTwice(0).first > 0, "tras el desalojo el acceso falla en la TLB");
+
+    accessMemory(1, 1, 0);
+    before = tlbStats();
+    releaseMemory(1);
+    ok &= check(tlbStats().hits >= before.hits, "las estadísticas del proceso liberado se conservan");
+    ok &= check(memoryAllocation(1) && accessTwice(0).first == 1, "el proceso cargado de nuevo empieza sin entradas");
+
+    size_t sets = tlbSets;
+    size_t ways = tlbWays;
+    configureTLB(8, 2);
+    ok &= check(accessTwice(0) == std::make_pair(1LL, 1LL), "cambiar la geometría vacía la TLB");
+    configureTLB(sets, ways);
+    return ok;
 }
 
-void uploadToRam(const std::vector<std::vector<std::string>> &segments, int process_id)
+// Al desalojar, una página limpia no se escribe en Swap y una sucia sí, con lo escrito
+bool testEvictionWritesBackDirtyPages()
 {
-    // Leer ambos archivos JSON existentes
-    std::ifstream ramJsonFile(jsonRAMPath);
-    std::ifstream swapJsonFile(jsonSwapPath);
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+    auto swapContent = [](int page)
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        return swapPageContent(findPage(*findProcess(1), 1, page)->frame_swap);
+    };
+    std::string first = swapContent(1);
+    std::string second = swapContent(2);
 
-    json jsonRAM;
-    json jsonSwap;
+    // Sin reclamador, el fallo de la página 2 desaloja la 1, que está limpia
+    long long clean = evictionStats.clean_evictions;
+    long long dirty = evictionStats.dirty_evictions;
+    long long written = evictionStats.bytes_written_back;
+    accessMemory(1, 1, pageSize);
+    ok &= check(evictionStats.clean_evictions == clean + 1 && evictionStats.dirty_evictions == dirty &&
+                    evictionStats.bytes_written_back == written,
+                "una página limpia se desaloja sin escribirla");
+    ok &= check(swapContent(1) == first, "el Swap de la página limpia no cambia");
+
+    ok &= check(writeMemory(1, 1, pageSize, "ZZ"), "escribir en la página 2");
+    ok &= check(swapContent(2) == second, "la escritura no llega al Swap hasta el desalojo");
+    accessMemory(1, 1, 0);
+    ok &= check(evictionStats.dirty_evictions == dirty + 1 &&
+                    evictionStats.bytes_written_back == written + static_cast<long long>(second.size()),
+                "una página sucia se escribe en Swap al desalojarla");
+    ok &= check(swapContent(2) == "ZZ" + second.substr(2), "el Swap tiene lo que se escribió");
+    return ok;
+}
+
+// Muchos hilos piden a la vez el fallo de la misma página: todos los future valen true,
+// los repetidos se unen al pendiente y la página se carga una sola vez
+bool testConcurrentFaultsOnOnePage()
+{
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+    FaultService &service = faultService();
+    long long submitted = service.submitted();
+    long long coalesced = service.coalesced();
+    long long completed = service.completed();
+    long long failed = service.failed();
+    long long clean = evictionStats.clean_evictions;
 
-    // Manejo del JSON principal
-    if (ramJsonFile.is_open())
+    std::atomic<int> falseResults{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
     {
-        ramJsonFile >> jsonRAM;
-        ramJsonFile.close();
+        threads.emplace_back([&falseResults]
+                             {
+            std::vector<std::shared_future<bool>> futures;
+            for (int i = 0; i < 20; ++i)
+            {
+                futures.push_back(memorySwapAsync(1, 2, 1));
+            }
+            for (auto &future : futures)
+            {
+                if (!future.get())
+                {
+                    falseResults++;
+                }
+            } });
     }
-
-    // Manejo del JSON secundario
-    if (swapJsonFile.is_open())
+    for (auto &thread : threads)
     {
-        swapJsonFile >> jsonSwap;
-        swapJsonFile.close();
+        thread.join();
     }
 
-    // **Verificar si el proceso ya existe en JSON principal**
-    auto &soEntries = jsonRAM["SO"];
-    for (auto it = soEntries.begin(); it != soEntries.end(); ++it)
+    ok &= check(falseResults == 0, "todos los future valen true");
+    ok &= check(service.submitted() - submitted == 160 && service.failed() == failed, "se atienden los 160 fallos sin errores");
+    ok &= check(service.completed() - completed == 160 - (service.coalesced() - coalesced),
+                "cada fallo repetido se une al pendiente en vez de atenderse otra vez");
+    // Sin reclamador, cargar la página 2 desaloja la 1; una segunda carga desalojaría otra vez
+    ok &= check(evictionStats.clean_evictions - clean == 1 && residentPages() == std::set<std::tuple<int, int, int>>{{1, 1, 2}, {1, 2, 1}, {1, 3, 1}},
+                "la página se carga una sola vez");
+    return ok;
+}
+
+// MappedProgram ve el archivo tal cual y la segmentación entera y la de flujo entregan
+// las mismas páginas, que juntas tienen todo el texto del programa en orden (las líneas
+// de la última parte se paginan sin su salto de línea, como con getline). Se prueban un
+// archivo vacío, uno sin salto de línea final y una línea más larga que una página.
+bool testProgramSegmentation()
+{
+    TestImage image(16, 64, "");
+    std::string withoutNewline = testProgram(10);
+    withoutNewline.pop_back();
+    std::string threeParts = testProgram(9);
+    threeParts.pop_back();
+    std::vector<std::pair<std::string, std::string>> programs = {
+        {"vacío", ""},
+        {"sin salto de línea final", withoutNewline},
+        {"de tres partes sin salto de línea final", threeParts},
+        {"con una línea larga", testProgram(4) + std::string(3 * pageSize + 7, 'L') + "\n" + testProgram(5)},
+    };
+
+    bool ok = true;
+    for (const auto &program : programs)
     {
-        if ((*it)["process_id"] == process_id)
+        std::ofstream(filePath, std::ios::trunc) << program.second;
+        auto withoutNewlines = [](std::string text)
         {
-            // Liberar memoria del proceso existente
-            releaseMemory(process_id);
+            text.erase(std::remove(text.begin(), text.end(), '\n'), text.end());
+            return text;
+        };
 
-            // **Actualizar jsonRAM tras liberar memoria**
-            // Leer de nuevo el archivo JSON principal para sincronizar los cambios
-            std::ifstream updatedRamJsonFile(jsonRAMPath);
-            if (updatedRamJsonFile.is_open())
-            {
-                updatedRamJsonFile >> jsonRAM;
-                updatedRamJsonFile.close();
-            }
-            else
-            {
-                std::cerr << "Error al leer JSON principal tras liberar memoria" << std::endl;
-                return;
-            }
+        MappedProgram mapped;
+        ok &= check(mapped.open(filePath) && mapped.text() == program.second, "MappedProgram ve el programa " + program.first);
 
-            // **Actualizar jsonSwap tras liberar memoria**
-            // Leer de nuevo el archivo JSON secundario para sincronizar los cambios
-            std::ifstream updatedSwapJsonFile(jsonSwapPath);
-            if (updatedSwapJsonFile.is_open())
+        MappedProgram wholeMapping;
+        vector<vector<string_view>> segments;
+        ok &= check(segmentProgram(filePath, wholeMapping, segments), "segmentar el programa " + program.first);
+        std::string joined;
+        bool pagesFit = true;
+        for (const auto &pages : segments)
+        {
+            for (auto page : pages)
             {
-                updatedSwapJsonFile >> jsonSwap;
-                updatedSwapJsonFile.close();
+                joined += page;
+                pagesFit = pagesFit && !page.empty() && page.size() <= static_cast<size_t>(pageSize);
             }
-            else
+        }
+        ok &= check(withoutNewlines(joined) == withoutNewlines(program.second), "las páginas forman el programa " + program.first);
+        if (program.second == threeParts)
+        {
+            // Sin parte incompleta, la última parte termina con el salto de línea que falta
+            ok &= check(joined == threeParts + "\n", "se añade el salto de línea final al programa " + program.first);
+        }
+        ok &= check(pagesFit, "ninguna página del programa " + program.first + " está vacía ni pasa de pageSize");
+
+        MappedProgram streamMapping;
+        vector<vector<std::string>> streamed;
+        ok &= check(segmentProgramStreaming(filePath, streamMapping, [&streamed](vector<string_view> &pages)
+                                            {
+            streamed.emplace_back(pages.begin(), pages.end());
+            return true; }),
+                    "segmentar en flujo el programa " + program.first);
+        bool same = streamed.size() == segments.size();
+        for (size_t i = 0; same && i < segments.size(); ++i)
+        {
+            same = std::equal(segments[i].begin(), segments[i].end(), streamed[i].begin(), streamed[i].end());
+        }
+        ok &= check(same, "el flujo entrega los mismos segmentos con el programa " + program.first);
+    }
+    return ok;
+}
+
+// La carga en flujo (memoryAllocation asigna cada segmento en cuanto está listo) deja la
+// misma tabla y el mismo contenido en Swap que segmentar todo el archivo y cargarlo después
+bool testStreamingMatchesWholeFile()
+{
+    std::string withoutNewline = testProgram(200);
+    withoutNewline.pop_back();
+    bool ok = true;
+    for (const std::string &program : {testProgram(200), withoutNewline})
+    {
+        TestImage image(64, 4096, program);
+        ok &= check(memoryAllocation(1), "cargar el programa en flujo");
+        MappedProgram mapped;
+        vector<vector<string_view>> segments;
+        ok &= check(segmentProgram(filePath, mapped, segments) && uploadToRam(segments, 2), "cargar el programa segmentado entero");
+
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        const ProcessTable &streamed = *findProcess(1);
+        const ProcessTable &whole = *findProcess(2);
+        bool same = streamed.segments.size() == whole.segments.size();
+        for (size_t i = 0; same && i < whole.segments.size(); ++i)
+        {
+            const auto &a = streamed.segments[i].pages;
+            const auto &b = whole.segments[i].pages;
+            same = a.size() == b.size();
+            for (size_t j = 0; same && j < b.size(); ++j)
             {
-                std::cerr << "Error al leer JSON secundario tras liberar memoria" << std::endl;
-                return;
+                same = a[j].offset == b[j].offset && a[j].size == b[j].size && a[j].presence_bit == b[j].presence_bit &&
+                       swapPageContent(a[j].frame_swap) == swapPageContent(b[j].frame_swap);
             }
-
-            break;
         }
+        ok &= check(same, "las dos cargas dejan los mismos segmentos, páginas y contenido");
     }
+    return ok;
+}
 
-    int ramFrame_id = 0;
-    int swapFrame_id = 0;
+// Segmenta program con la estrategia y compara segmentos, páginas y fragmentación interna
+// con los contados a mano (con pageSize = 50)
+bool segmenterReportIs(const std::shared_ptr<const Segmenter> &segmenter, const std::string &program,
+                       size_t segments, size_t pages, size_t fragmentation)
+{
+    TestImage image(16, 64, program);
+    SegmentationReport report = evaluateSegmenter(segmenter, filePath);
+    return check(report.segments == segments && report.pages == pages && report.fragmentation == fragmentation,
+                 report.strategy + ": " + std::to_string(report.segments) + " segmentos, " + std::to_string(report.pages) +
+                     " páginas y " + std::to_string(report.fragmentation) + " bytes de fragmentación");
+}
+
+// Reparto original: dos partes de 11 líneas y la última (9 líneas) paginada línea a línea
+bool testOriginalSegmenter()
+{
+    return segmenterReportIs(nullptr, testProgram(31), 3, 29, 161);
+}
 
-    // Crear un objeto para el proceso en el JSON principal
-    json processEntry;
-    processEntry["process_id"] = process_id;  // El ID del proceso
-    processEntry["segments"] = json::array(); // Inicializar el array de segmentos
+// 30 líneas en 4 segmentos iguales: 8, 8, 8 y 6 líneas
+bool testEqualSegmentsSegmenter()
+{
+    return segmenterReportIs(std::make_shared<EqualSegmentsSegmenter>(4), testProgram(30), 4, 27, 94);
+}
 
-    // Iterar sobre los segmentos y paginas para organizarlas en los JSON
-    for (size_t i = 0; i < segments.size(); ++i)
-    {
-        const auto &pages = segments[i];
+bool testFixedLinesSegmenter()
+{
+    return segmenterReportIs(std::make_shared<FixedLinesSegmenter>(10), testProgram(30), 3, 27, 94);
+}
+
+// Con segmentos de 8 páginas solo queda a medias la última página del programa
+bool testFixedBytesSegmenter()
+{
+    return segmenterReportIs(std::make_shared<FixedBytesSegmenter>(static_cast<size_t>(pageSize) * 8), testProgram(30), 4, 26, 44);
+}
 
-        // Crear las tablas de paginación para este proceso
-        json segmentEntry;
-        segmentEntry["segment_id"] = static_cast<int>(i + 1);
-        segmentEntry["pages"] = json::array();
+// Dos bloques de 39 bytes; las llaves de comentarios y caracteres no cuentan. Con un
+// mínimo de 60 bytes los dos bloques van juntos.
+bool testFunctionSegmenter()
+{
+    std::string program = "#include <x>\nint a()\n{\n    return 1;\n}\n// } no cierra\nint b() { return '}'; }\n";
+    bool ok = segmenterReportIs(std::make_shared<FunctionSegmenter>(), program, 2, 2, 22);
+    ok &= segmenterReportIs(std::make_shared<FunctionSegmenter>(60), program, 1, 2, 22);
+    return ok;
+}
 
-        // Guardar las paginas restantes en el JSON secundario
-        for (size_t j = 0; j < pages.size(); ++j)
+// Las funciones de saltos de línea por bloques dan lo mismo que contarlos byte a byte,
+// con saltos en los bordes de los bloques (0, 63, 64), al final y en textos que no
+// empiezan alineados ni terminan en un bloque entero
+bool testNewlineHelpers()
+{
+    size_t previousChunkBytes = paginationChunkBytes;
+    paginationChunkBytes = 2 * newlineBlock;
+    bool ok = true;
+    for (size_t length : {0, 1, 63, 64, 65, 127, 128, 200, 1000})
+    {
+        for (size_t start : {0, 1})
         {
-            // Buscar el próximo campo "libre" en el JSON secundario
-            while (swapFrame_id < jsonSwap["frames"].size() && jsonSwap["frames"][swapFrame_id]["is_free"] == false)
+            std::string buffer(length + start, 'a');
+            for (size_t offset : {size_t(0), size_t(63), size_t(64), length + start - 1, (length + start) / 2})
             {
-                swapFrame_id++; // Saltar campos ocupados
+                if (offset < buffer.size())
+                {
+                    buffer[offset] = '\n';
+                }
             }
-
-            if (swapFrame_id >= jsonSwap["frames"].size())
+            for (size_t offset = 3; offset < buffer.size(); offset += 37)
             {
-                std::cerr << "Memoria Swap Insuficiente" << std::endl;
-                return;
+                buffer[offset] = '\n';
             }
+            std::string_view text = std::string_view(buffer).substr(std::min(start, buffer.size()));
+            std::string label = " con " + std::to_string(text.size()) + " bytes desde " + std::to_string(start);
 
-            // Actualizar la entrada correspondiente en el JSON secundario
-            jsonSwap["frames"][swapFrame_id]["segment_id"] = static_cast<int>(i + 1);
-            jsonSwap["frames"][swapFrame_id]["page_number"] = static_cast<int>(j + 1);
-            jsonSwap["frames"][swapFrame_id]["content"] = pages[j];
-            jsonSwap["frames"][swapFrame_id]["process_id"] = process_id;
-            jsonSwap["frames"][swapFrame_id]["is_free"] = false; // Marcar como ocupado
+            vector<size_t> after; // Posición que sigue a cada salto de línea
+            for (size_t i = 0; i < text.size(); ++i)
+            {
+                if (text[i] == '\n')
+                {
+                    after.push_back(i + 1);
+                }
+            }
+            ok &= check(countNewlines(text) == static_cast<size_t>(std::count(text.begin(), text.end(), '\n')),
+                        "countNewlines" + label);
 
-            // Añadir la página en la tabla de paginación del segmento
-            json pageEntry;
-            pageEntry["page_number"] = static_cast<int>(j + 1);
-            pageEntry["frame_swap"] = swapFrame_id;
-            pageEntry["frame_ram"] = -1;
-            pageEntry["presence_bit"] = 0;
-            segmentEntry["pages"].push_back(pageEntry);
-        }
+            bool masks = true;
+            for (size_t position = 0; position < text.size(); position += newlineBlock)
+            {
+                uint64_t expected = 0;
+                for (size_t i = position; i < std::min(text.size(), position + newlineBlock); ++i)
+                {
+                    expected |= static_cast<uint64_t>(text[i] == '\n') << (i - position);
+                }
+                masks = masks && newlineMaskAt(text, position) == expected;
+            }
+            ok &= check(masks, "newlineMaskAt" + label);
 
-        // Guardar la primera subparte en el JSON principal
-        if (!pages.empty())
-        {
-            // Buscar el próximo campo "libre" en el JSON principal
-            while (ramFrame_id < jsonRAM["frames"].size() && jsonRAM["frames"][ramFrame_id]["is_free"] == false)
+            bool skips = skipLines(text, 0, after.size() + 1) == text.size();
+            vector<size_t> chunks = countNewlinesByChunk(text);
+            size_t chunkTotal = 0;
+            for (size_t count : chunks)
             {
-                ramFrame_id++; // Saltar campos ocupados
+                chunkTotal += count;
             }
+            bool chunked = chunkTotal == after.size();
+            for (size_t line = 1; line <= after.size(); ++line)
+            {
+                skips = skips && skipLines(text, 0, line) == after[line - 1];
+                chunked = chunked && positionAfterNewline(text, chunks, line) == after[line - 1];
+            }
+            ok &= check(skips, "skipLines" + label);
+            ok &= check(chunked, "countNewlinesByChunk y positionAfterNewline" + label);
 
-            if (ramFrame_id >= jsonRAM["frames"].size())
+            vector<size_t> starts;
+            if (!text.empty())
             {
-                std::cerr << "Memoria RAM Insuficiente" << std::endl;
-                return;
+                starts.push_back(0);
+                starts.insert(starts.end(), after.begin(), after.end());
+                if (starts.back() == text.size())
+                {
+                    starts.pop_back();
+                }
             }
+            ok &= check(indexLines(text) == starts, "indexLines" + label);
+        }
+    }
+    paginationChunkBytes = previousChunkBytes;
+    return ok;
+}
 
-            // Actualizar la entrada correspondiente en el JSON principal
-            jsonRAM["frames"][ramFrame_id]["segment_id"] = static_cast<int>(i + 1);
-            jsonRAM["frames"][ramFrame_id]["page_number"] = 1;
-            jsonRAM["frames"][ramFrame_id]["content"] = pages[0];
-            jsonRAM["frames"][ramFrame_id]["process_id"] = process_id;
-            jsonRAM["frames"][ramFrame_id]["is_free"] = false;
+// La paginación y la carga en paralelo por trozos dan las mismas páginas y la misma tabla
+// que el camino en serie, con un programa de varios trozos cuyos cortes caen a mitad de línea
+bool testParallelPagination()
+{
+    size_t previousParallelBytes = parallelPaginationBytes;
+    size_t previousChunkBytes = paginationChunkBytes;
+    std::string program = testProgram(3000);
+    TestImage image(64, 8192, program);
 
-            // Añadir la página en la tabla de paginación del segmento
-            segmentEntry["pages"][0]["frame_ram"] = ramFrame_id;
-            segmentEntry["pages"][0]["presence_bit"] = 1;
+    struct Result
+    {
+        vector<vector<std::string>> segments;
+        vector<std::string> views;
+        vector<std::string> lines;
+        vector<std::tuple<size_t, size_t, bool, std::string>> table;
+    };
+    auto run = [&program](int process_id)
+    {
+        Result result;
+        MappedProgram mapped;
+        vector<vector<string_view>> segments;
+        segmentProgram(filePath, mapped, segments);
+        for (const auto &pages : segments)
+        {
+            result.segments.emplace_back(pages.begin(), pages.end());
+        }
+        for (auto page : paginationView(program, pageSize))
+        {
+            result.views.emplace_back(page);
+        }
+        for (auto page : paginateLinesChunked(program))
+        {
+            result.lines.emplace_back(page);
         }
+        memoryAllocation(process_id);
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        for (const auto &segmentTable : findProcess(process_id)->segments)
+        {
+            for (const auto &entry : segmentTable.pages)
+            {
+                result.table.emplace_back(entry.offset, entry.size, entry.presence_bit, swapPageContent(entry.frame_swap));
+            }
+        }
+        return result;
+    };
 
-        // Añadir el segmento con sus páginas a la entrada del proceso
-        processEntry["segments"].push_back(segmentEntry);
-    }
-    // Agregar la entrada del proceso a la lista de procesos en RAM
-    jsonRAM["SO"].push_back(processEntry);
+    parallelPaginationBytes = 0;
+    Result serial = run(1);
+    parallelPaginationBytes = 1;
+    paginationChunkBytes = 1000; // Más de cien trozos, con cortes a mitad de línea y de página
+    Result parallel = run(2);
+    parallelPaginationBytes = previousParallelBytes;
+    paginationChunkBytes = previousChunkBytes;
+
+    bool ok = check(!serial.segments.empty() && parallel.segments == serial.segments, "segmentProgram da los mismos segmentos");
+    ok &= check(parallel.views == serial.views, "paginationView da las mismas páginas");
+    ok &= check(parallel.lines == serial.lines, "paginateLinesChunked da las mismas páginas");
+    ok &= check(!serial.table.empty() && parallel.table == serial.table, "la carga en paralelo deja la misma tabla y el mismo Swap");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran");
+    return ok;
+}
 
-    // Guardar los JSON actualizados en sus archivos correspondientes
-    std::ofstream archivoPrincipalJsonSalida(jsonRAMPath);
-    if (archivoPrincipalJsonSalida.is_open())
+// forkProcess: el hijo comparte las páginas del padre, su primera escritura copia la
+// página sin cambiar la del padre y, si el padre se libera antes, el hijo se queda con
+// los frames compartidos y sus contadores
+bool testForkCopyOnWrite()
+{
+    TestImage image(64, 4096, testProgram(60));
+    bool ok = check(memoryAllocation(1) && forkProcess(1, 2), "cargar el proceso y clonarlo");
+    std::string original;
+    for (size_t offset = 0; offset < 10; ++offset)
     {
-        archivoPrincipalJsonSalida << jsonRAM.dump(4); // Escribir el JSON principal formateado con 4 espacios
-        archivoPrincipalJsonSalida.close();
+        original += accessMemory(1, 1, offset);
     }
+    auto sameFrame = []()
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        const PageTableEntry *parent = findPage(*findProcess(1), 1, 1);
+        const PageTableEntry *child = findPage(*findProcess(2), 1, 1);
+        return parent->presence_bit && child->presence_bit && parent->frame_ram == child->frame_ram;
+    };
+    ok &= check(accessMemory(2, 1, 0) == original[0] && sameFrame(), "el hijo lee la página del frame del padre");
 
-    std::ofstream archivoSecundarioJsonSalida(jsonSwapPath);
-    if (archivoSecundarioJsonSalida.is_open())
+    long long cowCopies = dedupStats.cow_copies;
+    ok &= check(writeMemory(2, 1, 0, "HIJO"), "el hijo escribe en la página compartida");
+    ok &= check(dedupStats.cow_copies > cowCopies && !sameFrame(), "la escritura copia la página");
+    std::string parent;
+    std::string child;
+    for (size_t offset = 0; offset < 10; ++offset)
     {
-        archivoSecundarioJsonSalida << jsonSwap.dump(4); // Escribir el JSON secundario formateado con 4 espacios
-        archivoSecundarioJsonSalida.close();
+        parent += accessMemory(1, 1, offset);
+        child += accessMemory(2, 1, offset);
     }
+    ok &= check(parent == original, "la página del padre no cambia");
+    ok &= check(child == "HIJO" + original.substr(4), "el hijo ve lo que escribió");
 
-    std::cout << "JSON principal y secundario actualizados correctamente." << std::endl;
+    char second = accessMemory(1, 1, pageSize);
+    releaseMemory(1);
+    ok &= check(usedMem(1) == 0 && countersMatchFrames({1, 2}), "los frames compartidos pasan al hijo al liberar al padre");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran tras liberar primero al padre");
+    ok &= check(accessMemory(2, 1, pageSize) == second, "el hijo sigue leyendo las páginas que compartía");
+    releaseMemory(2);
+    ok &= check(ramFramesAccounted(), "liberar al hijo devuelve los frames");
+    return ok;
 }
 
-// Función para dividir el archivo en segment y pages
-bool memoryAllocation(int process_id) // solo pid
+// Páginas grandes en la imagen local: cada página ocupa 4 frames seguidos de RAM y de
+// Swap, se desaloja y se vuelve a cargar entera y al fijarla cuenta sus 4 frames
+bool testLocalHugePages()
 {
-    ifstream archivo(filePath);
-    int segmentSize = ceil(countLines(filePath) / 3.0); // Número de líneas por parte
-    int pageSize = 50;
+    int previousFrames = hugePageFrames;
+    size_t previousMinBytes = hugePageMinBytes;
+    std::string program = testProgram(60);
+    TestImage image(64, 4096, program);
+    configureHugePages(4, 0);
+    bool ok = check(memoryAllocation(1), "cargar el proceso con páginas grandes");
+    size_t hugeBytes = 4 * static_cast<size_t>(pageSize);
 
-    if (!archivo.is_open())
+    auto contiguous = [](const std::vector<Frame> &frames, int first)
     {
-        cerr << "No se pudo abrir el archivo: " << filePath << endl;
-        return {};
-    }
-
-    vector<vector<string>> segment;
-    vector<string> currentSegment;
-    string line;
-    int lineCounter = 0;
-
-    while (getline(archivo, line))
+        bool run = first >= 0 && first + 4 <= static_cast<int>(frames.size()) && frames[first].span == 4;
+        for (int i = 0; run && i < 4; ++i)
+        {
+            run = !frames[first + i].is_free && frames[first + i].process_id == frames[first].process_id && (i == 0 || frames[first + i].span == 0);
+        }
+        return run;
+    };
     {
-        currentSegment.push_back(line);
-        lineCounter++;
-
-        // Si alcanzamos el límite de líneas por parte, procesamos la parte
-        if (lineCounter == segmentSize)
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        bool runs = true;
+        for (const auto &segmentTable : findProcess(1)->segments)
         {
-            vector<string> pages;
-            string segmentString;
-            for (const auto &l : currentSegment)
+            runs = runs && segmentTable.page_size == hugeBytes;
+            for (const auto &entry : segmentTable.pages)
             {
-                segmentString += l + "\n";
+                runs = runs && contiguous(swapFrames, entry.frame_swap) && (!entry.presence_bit || contiguous(ramFrames, entry.frame_ram));
             }
-            auto pageInProgress = pagination(segmentString, pageSize);
-            pages.insert(pages.end(), pageInProgress.begin(), pageInProgress.end());
-            segment.push_back(pages);
-            currentSegment.clear();
-            lineCounter = 0;
         }
+        ok &= check(runs, "cada página grande ocupa 4 frames seguidos en RAM y en Swap");
     }
+    ok &= check(countersMatchFrames({1}) && ramFramesAccounted(), "los contadores cuentan los 4 frames de cada página");
 
-    // Procesar la última parte si quedó incompleta
-    if (!currentSegment.empty())
+    auto readPage = [hugeBytes]()
     {
-        vector<string> pages;
-        for (const auto &l : currentSegment)
+        std::string content;
+        for (size_t offset = 0; offset < hugeBytes; ++offset)
         {
-            auto pageInProgress = pagination(l, pageSize);
-            pages.insert(pages.end(), pageInProgress.begin(), pageInProgress.end());
+            content += accessMemory(1, 1, offset);
         }
-        segment.push_back(pages);
-    }
+        return content;
+    };
+    ok &= check(readPage() == program.substr(0, hugeBytes), "la primera página grande tiene el principio del programa");
+    accessMemory(1, 1, hugeBytes); // Sin reclamador, desaloja la primera página del segmento
+    ok &= check(residentPages().count({1, 1, 1}) == 0, "la página grande se desaloja");
+    ok &= check(readPage() == program.substr(0, hugeBytes) && residentPages().count({1, 1, 1}) == 1, "la página grande se vuelve a cargar entera");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran tras el desalojo y la recarga");
 
-    archivo.close();
-    uploadToRam(segment, process_id);
-    return true;
+    int pinned = pinnedMem();
+    ok &= check(pinPage(1, 1, 1) && pinnedMem() - pinned == static_cast<int>(hugeBytes), "fijar una página grande cuenta sus 4 frames");
+    ok &= check(unpinPage(1, 1, 1) && pinnedMem() == pinned, "soltarla los descuenta");
+
+    configureHugePages(previousFrames, previousMinBytes);
+    return ok;
 }
 
-string getPage(int frame_number)
+// Sin persistencia inmediata las consultas ven cada fallo, fijación, escritura y liberación
+// en el momento, sin esperar a ningún punto de control
+bool testQueriesFollowOperations()
 {
-    ifstream inputFile(jsonSwapPath);
-    json jsonData;
-    inputFile >> jsonData;
-    inputFile.close();
+    TestImage image(64, 4096, testProgram(120));
+    bool ok = check(memoryAllocation(1) && memoryAllocation(2), "cargar los procesos de la prueba");
+    ok &= check(countersMatchFrames({1, 2}), "contadores tras cargar");
+    ok &= check(pinnedMem() == 0 && pinPage(1, 1, 3) && pinnedMem() == pageSize, "pinnedMem ve la fijación en el momento");
+    ok &= check(countersMatchFrames({1, 2}), "contadores tras fijar");
 
-    string content;
-    // Busca el frame que tiene la página y obtiene el contenido
-    for (auto &frame : jsonData["frames"])
+    ok &= check(memorySwap(2, 4, 2) && accessMemory(2, 3, 0) != 0 && writeMemory(2, 1, 10, "abc"), "fallos y escrituras del proceso 2");
+    ok &= check(countersMatchFrames({1, 2}), "contadores tras los fallos");
+
+    releaseMemory(1);
+    ok &= check(pinnedMem() == 0 && usedMem(1) == 0, "liberar el proceso quita su memoria fijada y usada");
+    ok &= check(countersMatchFrames({1, 2}), "contadores tras liberar");
     {
-        if (frame["frame_number"] == frame_number)
-        {
-            content = frame["content"];
-            break;
-        }
+        SnapshotReader snapshot;
+        ok &= check(snapshot && snapshot->processes.count(1) == 0 && snapshot->processes.count(2) == 1,
+                    "el registro de contadores retira el proceso liberado");
     }
+    return ok;
+}
 
-    return content;
+// Hilos que consultan los contadores sin parar mientras otro carga y libera procesos:
+// nunca ven valores imposibles y leen los contadores retirados sin esperar a nadie
+bool testQueriesDuringReleases()
+{
+    TestImage image(64, 4096, testProgram(60));
+    std::atomic<bool> stop{false};
+    std::atomic<long long> impossible{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i)
+    {
+        readers.emplace_back([&stop, &impossible]()
+                             {
+                                 while (!stop)
+                                 {
+                                     for (int process_id = 1; process_id <= 3; ++process_id)
+                                     {
+                                         ProcessFrameCounts counts = readProcessCounters(process_id);
+                                         impossible += counts.ram_frames < 0 || counts.swap_frames < 0 || usedMem(process_id) < 0 ? 1 : 0;
+                                     }
+                                     impossible += freeMem() < 0 ? 1 : 0;
+                                 } });
+    }
+    bool ok = true;
+    for (int round = 0; round < 50; ++round)
+    {
+        int process_id = 1 + round % 3;
+        ok &= memoryAllocation(process_id);
+        releaseMemory(process_id);
+    }
+    stop = true;
+    for (auto &reader : readers)
+    {
+        reader.join();
+    }
+    ok = check(ok, "cargar y liberar los procesos");
+    ok &= check(impossible == 0, "las consultas nunca ven contadores negativos");
+    ok &= check(freeMem() == 64 * pageSize && usedMem(1) == 0, "al final toda la RAM está libre");
+    return ok;
 }
 
-void updateTable(int segmento, int pagina, int process_id, int new_page_ram_frame)
+// Sin persistencia inmediata los JSON solo cambian en los puntos de control explícitos
+bool testExplicitCheckpoint()
+{
+    std::string program = testProgram(40);
+    TestImage image(64, 4096, program);
+    bool ok = check(memoryAllocation(1), "cargar el proceso de la prueba");
+    persistMemoryImage();
+
+    ok &= check(writeMemory(1, 1, 10, "abc"), "escribir en el proceso");
+    ok &= check(loadMemoryImage() && accessMemory(1, 1, 10) == program[10], "sin punto de control la escritura no llega a los JSON");
+
+    ok &= check(writeMemory(1, 1, 10, "abc"), "volver a escribir en el proceso");
+    persistMemoryImage();
+    ok &= check(loadMemoryImage() && accessMemory(1, 1, 10) == 'a' && accessMemory(1, 1, 12) == 'c', "el punto de control guarda la escritura");
+    ok &= check(countersMatchFrames({1}), "contadores tras recargar la imagen");
+    return ok;
+}
+
+// Varios hilos reservan y liberan frames de un pool pequeño (así también se agota y
+// los magazines tienen que devolver frames): ninguno se entrega a dos hilos a la vez y al
+// terminar vuelven todos al bitmap
+bool testFrameAllocatorStress()
 {
-    ifstream inputFile(jsonRAMPath);
-    json jsonData;
-    inputFile >> jsonData;
-    inputFile.close();
+    std::vector<Frame> pool(512);
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        pool[i] = {"", static_cast<int>(i), true, 0, 0, 0, 0};
+    }
 
-    for (auto &process : jsonData["SO"])
+    bool ok = true;
+    for (int threads : {4, 16})
     {
-        if (process["process_id"] == process_id)
+        for (bool useMagazines : {false, true})
         {
-            for (auto &segmentos : process["segments"])
-            {
-                if (segmentos["segment_id"] == segmento)
-                {
-                    for (auto &paginas : segmentos["pages"])
-                    {
-                        if (paginas["page_number"] == pagina)
-                        {
-                            paginas["frame_ram"] = new_page_ram_frame;
-                            paginas["presence_bit"] = 1;
-                        }
-                    }
-                }
-            }
+            FrameAllocatorRun run = runFrameAllocator(pool, threads, useMagazines, 20000, true);
+            std::string mode = std::string(useMagazines ? "magazines" : "bitmap") + " con " + std::to_string(threads) + " hilos";
+            ok &= check(run.doubleClaims == 0, "ningún frame reservado dos veces (" + mode + ")");
+            ok &= check(run.freeAtEnd == pool.size(), "todos los frames vuelven al bitmap (" + mode + ")");
         }
     }
-
-    // Guarda el archivo JSON con los cambios
-    ofstream outputFile(jsonRAMPath);
-    outputFile << jsonData.dump(4);
-    outputFile.close();
+    return ok;
 }
 
-bool memorySwap(int segment, int page, int process_id)
+#if defined(__cpp_impl_coroutine)
+// Muchas tareas con corrutinas leen dos procesos en una RAM pequeña: las que provocan un
+// fallo de página se suspenden y al reanudarse leen lo mismo que accessMemory
+bool testCoroutineTasks()
 {
-    ifstream inputFile(jsonRAMPath);
-    json jsonData;
-    inputFile >> jsonData;
-    inputFile.close();
+    std::string program = testProgram(40);
+    TestImage image(8, 4096, program);
+    CoroutineExecutor executor;
+    bool allocated = false;
+    executor.spawn(memoryAllocationTask(executor, 1), [&allocated](bool result)
+                   { allocated = result; });
+    executor.run();
+    bool ok = check(allocated && memoryAllocation(2), "cargar los procesos de la prueba");
 
-    int frame_number_swap = 0;
-    int frame_number_Ram = 0;
-    for (auto &process : jsonData["SO"])
+    size_t length = 0;
     {
-        if (process["process_id"] == process_id)
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        for (const auto &entry : findProcess(1)->segments[0].pages)
         {
-            for (auto &segmentos : process["segments"])
-            {
-                if (segmentos["segment_id"] == segment)
-                {
-                    for (auto &paginas : segmentos["pages"])
-                    {
-                        if (paginas["page_number"] == page)
-                        {
-                            frame_number_swap = paginas["frame_swap"];
-                        }
-                        if (paginas["presence_bit"] == 1)
-                        {
-                            frame_number_Ram = paginas["frame_ram"];
-                            paginas["frame_ram"] = -1;
-                            paginas["presence_bit"] = 0;
-                        }
-                    }
-                }
-            }
+            length += entry.size;
         }
     }
-    int new_ram_frame_assigned = 0;
-    bool assigned = false;
-    for (auto &frame : jsonData["frames"])
+    std::vector<char> values(2 * length, 0);
+    for (size_t offset = 0; offset < length; ++offset)
     {
-        if (frame["is_free"] && !assigned)
-        {
-            frame["is_free"] = false;       // Actualizar is_free
-            frame["segment_id"] = segment; // Reiniciar segment_id
-            frame["page_number"] = page;  // Reiniciar page_number
-            frame["content"] = getPage(frame_number_swap);
-            frame["process_id"] = process_id;
-            new_ram_frame_assigned = frame["frame_number"];
-            assigned = true;
-        }
-        if (frame["frame_number"] == frame_number_Ram)
+        for (int process_id : {1, 2})
         {
-            frame["is_free"] = true;  // Actualizar is_free
-            frame["segment_id"] = 0;  // Reiniciar segment_id
-            frame["page_number"] = 0; // Reiniciar page_number
-            frame["content"] = "";    // Limpiar contenido
-            frame["process_id"] = 0;
+            char *value = &values[(process_id - 1) * length + offset];
+            executor.spawn(accessMemoryTask(executor, process_id, 1, offset), [value](char result)
+                           { *value = result; });
         }
     }
+    executor.run();
+    ok &= check(executor.failedTasks() == 0, "ninguna tarea falla");
+    bool same = length > 0;
+    for (size_t offset = 0; offset < length; ++offset)
+    {
+        same = same && values[offset] == program[offset] && values[length + offset] == program[offset];
+    }
+    ok &= check(same, "las tareas leen el programa de los dos procesos");
 
-    // Guarda el archivo JSON con los cambios
-    ofstream outputFile(jsonRAMPath);
-    outputFile << jsonData.dump(4);
-    outputFile.close();
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran");
 
-    updateTable(segment, page, process_id, new_ram_frame_assigned);
-    return true;
+    TestImage small(8, 4, program); // No caben las páginas en Swap
+    executor.spawn(memoryAllocationTask(executor, 3), [&allocated](bool result)
+                   { allocated = result; });
+    executor.run();
+    ok &= check(!allocated, "la tarea de carga informa de que no hay memoria");
+    return ok;
+}
+#endif
+
+// Varias cargas a la vez del mismo proceso: queda una sola tabla y los frames de las
+// demás vuelven a estar libres. Una carga fallida deja el proceso como estaba.
+bool testConcurrentAllocation()
+{
+    std::string program = testProgram(120);
+    TestImage image(256, 4096, program);
+    std::atomic<int> loaded{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i)
+    {
+        threads.emplace_back([&loaded]()
+                             {
+                                 for (int round = 0; round < 10; ++round)
+                                 {
+                                     loaded += memoryAllocation(1) ? 1 : 0;
+                                 } });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    bool ok = check(loaded == 80, "todas las cargas terminan bien");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran tras las cargas");
+    ok &= check(accessMemory(1, 1, 5) == program[5], "el proceso tiene su programa");
+
+    std::string savedPath = filePath;
+    filePath += ".inexistente";
+    ok &= check(!memoryAllocation(1), "la carga de un programa que no existe falla");
+    filePath = savedPath;
+    ok &= check(usedMem(1) > 0 && accessMemory(1, 1, 5) == program[5], "la carga fallida no quita el proceso");
+
+    releaseMemory(1);
+    swapPool.flushLocal();
+    ok &= check(ramFramesAccounted() && swapPool.available() == 4096, "liberar el proceso devuelve todos los frames");
+    return ok;
+}
+
+// Un hilo que termina después de recargar la imagen no devuelve al bitmap nuevo los
+// frames que guardaba su magazine: ya pueden tener otra página
+bool testMagazinesAcrossReload()
+{
+    TestImage image(64, 4096, testProgram(60));
+    std::promise<void> filled;
+    std::promise<void> reloaded;
+    std::shared_future<void> canExit = reloaded.get_future().share();
+    bool loaded = false;
+    std::thread worker([&]()
+                       {
+                           loaded = memoryAllocation(2);
+                           releaseMemory(2); // Sus frames quedan en el magazine del hilo
+                           filled.set_value();
+                           canExit.wait(); });
+
+    filled.get_future().wait();
+    bool ok = check(loadMemoryImage() && memoryAllocation(2), "recargar la imagen y volver a cargar el proceso");
+    reloaded.set_value();
+    worker.join();
+    ok &= check(loaded, "el hilo carga su proceso");
+    ok &= check(ramFramesAccounted(), "los frames de RAM cuadran cuando el hilo termina");
+    return ok;
+}
+
+// Ejecuta check en un proceso hijo y devuelve si terminó bien
+bool inChildProcess(const std::function<bool()> &check)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        _exit(check() ? 0 : 1);
+    }
+    int status = 0;
+    return child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Dos procesos sobre la misma imagen compartida: cada uno ve en el momento las escrituras
+// y las altas del otro (también con páginas grandes), y si uno muere con el lock de un
+// proceso tomado, el siguiente lo recupera
+bool testSharedImageAcrossProcesses()
+{
+    std::string program = testProgram(200);
+    TestImage image(128, 4096, program);
+    std::string name = "/memorymanager-pruebas-" + std::to_string(getpid());
+    shm_unlink(name.c_str());
+
+    bool ok = check(attachSharedImage(name), "crear la imagen compartida");
+    ok &= check(memoryAllocation(1) && writeMemory(1, 1, 0, "AB"), "cargar y escribir el proceso 1");
+    configureHugePages(4, 1);
+    ok &= check(inChildProcess([&name]()
+                               {
+                                   detachSharedImage();
+                                   return attachSharedImage(name) && accessMemory(1, 1, 1) == 'B' &&
+                                          writeMemory(1, 1, 2, "cd") && memoryAllocation(2) && writeMemory(2, 1, 5, "grande");
+                               }),
+                "el otro proceso ve la escritura, escribe y carga el proceso 2");
+    configureHugePages(1, 0);
+    ok &= check(accessMemory(1, 1, 2) == 'c' && accessMemory(1, 1, 3) == 'd', "se ve la escritura del otro proceso");
+    ok &= check(accessMemory(2, 1, 5) == 'g' && accessMemory(2, 1, 10) == 'e' && accessMemory(2, 1, 11) == program[11],
+                "se ve el proceso 2 (páginas grandes) cargado por el otro proceso");
+    {
+        std::shared_lock<std::shared_mutex> imageLock(imageMutex);
+        ProcessTable *table = findProcess(2);
+        ok &= check(table != nullptr && table->segments[0].page_size > static_cast<size_t>(pageSize), "el proceso 2 usa páginas grandes");
+    }
+
+    ok &= check(!inChildProcess([]()
+                                {
+                                    SharedImageTransaction transaction({1});
+                                    raise(SIGKILL);
+                                    return true;
+                                }),
+                "el otro proceso muere con el lock del proceso 1");
+    ok &= check(writeMemory(1, 1, 0, "Z") && accessMemory(1, 1, 0) == 'Z', "el lock del proceso 1 se recupera");
+
+    releaseMemory(1);
+    releaseMemory(2);
+    ok &= check(usedMem(1) == 0 && usedMem(2) == 0 && freeMem() == 128 * pageSize, "liberar devuelve todos los frames");
+    detachSharedImage(true);
+    return ok;
+}
+
+// Unirse a una imagen compartida cuyo creador murió antes de terminarla falla enseguida,
+// y a una que nadie termina de crear, al agotar el tiempo
+bool testSharedImageAttachTimeout()
+{
+    TestImage image(16, 64, testProgram(10));
+    std::string name = "/memorymanager-pruebas-" + std::to_string(getpid());
+    shm_unlink(name.c_str());
+
+    bool ok = check(inChildProcess([&name]()
+                                   {
+                                       bool exists;
+                                       return sharedImage.create(name, 16, 64, 4, static_cast<size_t>(pageSize), exists);
+                                   }),
+                    "otro proceso empieza a crear la imagen y termina");
+    auto start = std::chrono::steady_clock::now();
+    ok &= check(!attachSharedImage(name, 256, std::chrono::milliseconds(5000)) &&
+                    std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000),
+                "no se espera a un creador que ya terminó");
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    ok &= check(fd != -1, "crear una región vacía");
+    close(fd);
+    start = std::chrono::steady_clock::now();
+    ok &= check(!attachSharedImage(name, 256, std::chrono::milliseconds(100)) &&
+                    std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000),
+                "la espera termina al agotar el tiempo");
+    shm_unlink(name.c_str());
+    return ok;
+}
+
+// Ejecuta todas las pruebas y muestra el resultado de cada una
+bool runSelfTests()
+{
+    bool previousWriteThrough = writeThroughPersistence;
+    writeThroughPersistence = false;
+
+    std::vector<std::pair<std::string, bool (*)()>> tests = {
+        {"memorySwapBatch sin frames suficientes", testSwapBatchWithoutFrames},
+        {"memorySwapBatch con páginas inexistentes", testSwapBatchMissingPage},
+        {"memorySwapBatch con frames de Swap compartidos", testSwapBatchFrameOwner},
+        {"Páginas fijadas fuera de los desalojos", testPinnedPagesSkipped},
+        {"Segunda oportunidad entre vueltas del reclamador", testReclaimSecondChance},
+        {"Deduplicación de páginas", testPageDeduplication},
+        {"Compresión LZ de ida y vuelta", testLzRoundTrip},
+        {"Consultas al día sin puntos de control", testQueriesFollowOperations},
+        {"Consultas mientras se liberan procesos", testQueriesDuringReleases},
+        {"Puntos de control explícitos", testExplicitCheckpoint},
+        {"Asignadores de frames bajo estrés", testFrameAllocatorStress},
+        {"Shards sobre un bitmap compartido", testAttachedShards},
+        {"Cargas simultáneas del mismo proceso", testConcurrentAllocation},
+        {"Carga de procesos por lotes", testAllocationBatch},
+        {"Aciertos e invalidaciones de la TLB", testTLBHitsAndInvalidations},
+        {"Escritura en Swap solo de páginas sucias", testEvictionWritesBackDirtyPages},
+        {"Fallos simultáneos sobre la misma página", testConcurrentFaultsOnOnePage},
+        {"Segmentación del texto del programa", testProgramSegmentation},
+        {"Carga en flujo igual que la del archivo entero", testStreamingMatchesWholeFile},
+        {"Segmentador original", testOriginalSegmenter},
+        {"Segmentador de segmentos iguales", testEqualSegmentsSegmenter},
+        {"Segmentador de líneas fijas", testFixedLinesSegmenter},
+        {"Segmentador de bytes fijos", testFixedBytesSegmenter},
+        {"Segmentador de funciones de C++", testFunctionSegmenter},
+        {"Búsqueda de saltos de línea por bloques", testNewlineHelpers},
+        {"Paginación en paralelo igual que en serie", testParallelPagination},
+        {"Copia al escribir tras forkProcess", testForkCopyOnWrite},
+        {"Páginas grandes en la imagen local", testLocalHugePages},
+#if defined(__cpp_impl_coroutine)
+        {"Tareas con corrutinas", testCoroutineTasks},
+#endif
+        {"Magazines de hilos que terminan tras recargar la imagen", testMagazinesAcrossReload},
+        {"Imagen compartida entre procesos", testSharedImageAcrossProcesses},
+        {"Espera al unirse a una imagen compartida", testSharedImageAttachTimeout},
+    };
+
+    bool passed = true;
+    for (const auto &test : tests)
+    {
+        bool ok = test.second();
+        cout << (ok ? "OK    " : "FALLO ") << test.first << endl;
+        passed = passed && ok;
+    }
+
+    writeThroughPersistence = previousWriteThrough;
+    return passed;
 }
-int main()
+
+int main(int argc, char *argv[])
 {
+    // Con --pruebas solo se ejecutan las pruebas del gestor, sobre imágenes temporales;
+    // con --benchmark, la medida de los asignadores de frames
+    if (argc > 1 && std::string(argv[1]) == "--pruebas")
+    {
+        return runSelfTests() ? 0 : 1;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--benchmark")
+    {
+        benchmarkFrameAllocator();
+        return 0;
+    }
+
     // MEMORY ALLOCATION
     int process_id = 0;
 
@@ -577,5 +8863,8 @@ int main()
     // cout << "Memoria disponible: " << freeMem() << " KB" << endl;
     memorySwap(1, 3, 0);
 
+    // Punto de control: guarda en los JSON lo que cambiaron las operaciones anteriores
+    persistMemoryImage();
+
     return 0;
 }
\ No newline at end of file